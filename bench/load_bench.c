@@ -0,0 +1,796 @@
+// HTTP load generator: every thread drives its share of the connections through its own epoll loop,
+// requests are spread over a weighted url mix, latencies go to a log-linear histogram per thread.
+// Prints throughput and latency percentiles as JSON; with -S it starts the server on loopback itself,
+// with -x it runs the standard scenario matrix (server modes x keep-alive/close x concurrency).
+//
+// usage: bench [-H host] [-p port] [-t threads] [-c connections] [-d seconds] [-C] [-u url[=weight],...]
+//              [-r root] [-S server] [-a "server args"] [-x]
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+// the kernel's tcp_info, glibc's lacks the data segment counters
+#include <linux/tcp.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_HOST "127.0.0.1"
+#define DEFAULT_PORT 8100
+#define DEFAULT_THREADS 2
+#define DEFAULT_CONNS 64
+#define DEFAULT_SECONDS 5
+#define DEFAULT_ROOT "./static"
+
+#define MAX_TARGETS 1024
+#define MAX_SERVER_ARGS 32
+#define REQUEST_LEN 512
+#define HEADER_BUFF 16384
+#define EVENTS_NUM 256
+#define TICK_MS 50
+#define SERVER_START_MS 5000
+
+// latencies in nanoseconds, 8 sub-buckets per power of two up to 2^36 ns (~69 s)
+#define HIST_SUB_BITS 3
+#define HIST_MAX_BITS 36
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+typedef struct target {
+    char url[256];
+    char request[REQUEST_LEN];
+    size_t requestLen;
+    unsigned weight;
+} targetT;
+
+typedef struct scenario {
+    const char *name;
+    const char *host;
+    int port;
+    int threads;
+    int conns;
+    double seconds;
+    bool keepAlive;
+
+    targetT *targets;
+    int nTargets;
+    unsigned totalWeight;
+} scenarioT;
+
+typedef enum clientState {
+    CLIENT_CONNECTING, CLIENT_SENDING, CLIENT_READING
+} clientStateT;
+
+typedef struct client {
+    int fd;
+    clientStateT state;
+    const targetT *target;
+    size_t sent;
+    long long startNs;
+
+    // header block of the response being read, then the body bytes still expected
+    char head[HEADER_BUFF];
+    size_t headLen;
+    bool headDone;
+    int status;
+    long long bodyLeft;
+    bool serverCloses;
+} clientT;
+
+typedef struct stats {
+    unsigned long long requests, errors, non2xx, connects, bytes;
+    // data segments received from the server, the packets its responses took
+    unsigned long long segments;
+    unsigned long long hist[HIST_BUCKETS];
+    unsigned long long maxNs, sumNs;
+} statsT;
+
+typedef struct worker {
+    pthread_t thread;
+    scenarioT *scenario;
+    int epfd;
+    clientT *clients;
+    int nClients;
+    uint64_t rng;
+    long long deadlineNs;
+    statsT stats;
+} workerT;
+
+void *worker_routine(void *arg);
+
+int client_open(workerT *worker, clientT *client);
+
+void client_close(workerT *worker, clientT *client);
+
+void client_fail(workerT *worker, clientT *client);
+
+void client_start_request(workerT *worker, clientT *client);
+
+int client_send(workerT *worker, clientT *client);
+
+int client_read(workerT *worker, clientT *client);
+
+int parse_head(clientT *client);
+
+void on_response(workerT *worker, clientT *client);
+
+const targetT *pick_target(workerT *worker);
+
+int add_target(scenarioT *scenario, const char *url, unsigned weight);
+
+int parse_urls(scenarioT *scenario, const char *list);
+
+int scan_root(scenarioT *scenario, const char *root);
+
+int collect_file(const char *path, const struct stat *st, int type, struct FTW *ftw);
+
+int run_scenario(scenarioT *scenario, statsT *total, double *elapsed);
+
+void print_json(scenarioT *scenario, const char *mode, statsT *stats, double elapsed);
+
+double percentile_us(statsT *stats, double q);
+
+int bucket_index(unsigned long long ns);
+
+unsigned long long bucket_limit(int bucket);
+
+pid_t start_server(const char *path, const char *args, const char *mode, int port);
+
+void stop_server(pid_t pid);
+
+int wait_port(const char *host, int port, int timeout_ms);
+
+long long now_ns();
+
+// nftw has no user argument
+scenarioT *scan_scenario = NULL;
+size_t scan_root_len = 0;
+
+void *worker_routine(void *arg) {
+    workerT *worker = (workerT *) arg;
+    struct epoll_event events[EVENTS_NUM];
+
+    for (int i = 0; i < worker->nClients; ++i) {
+        worker->clients[i].fd = -1;
+        client_start_request(worker, &worker->clients[i]);
+    }
+
+    while (now_ns() < worker->deadlineNs) {
+        int n = epoll_wait(worker->epfd, events, EVENTS_NUM, TICK_MS);
+        if (n < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; ++i) {
+            clientT *client = (clientT *) events[i].data.ptr;
+            if (client->fd < 0) {
+                continue;
+            }
+            int rc;
+            if (client->state == CLIENT_READING) {
+                rc = client_read(worker, client);
+            } else {
+                rc = client_send(worker, client);
+            }
+            if (rc < 0) {
+                client_fail(worker, client);
+            }
+        }
+        // connections that could not be opened are retried once per wakeup
+        for (int i = 0; i < worker->nClients; ++i) {
+            if (worker->clients[i].fd < 0) {
+                client_start_request(worker, &worker->clients[i]);
+            }
+        }
+    }
+
+    for (int i = 0; i < worker->nClients; ++i) {
+        client_close(worker, &worker->clients[i]);
+    }
+    return NULL;
+}
+
+int client_open(workerT *worker, clientT *client) {
+    scenarioT *scenario = worker->scenario;
+    client->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (client->fd < 0) {
+        return -1;
+    }
+    int one = 1;
+    setsockopt(client->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(scenario->port)};
+    inet_pton(AF_INET, scenario->host, &addr.sin_addr);
+    if (connect(client->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        close(client->fd);
+        client->fd = -1;
+        return -1;
+    }
+    worker->stats.connects++;
+
+    struct epoll_event event = {.events = EPOLLOUT, .data.ptr = client};
+    if (epoll_ctl(worker->epfd, EPOLL_CTL_ADD, client->fd, &event) < 0) {
+        close(client->fd);
+        client->fd = -1;
+        return -1;
+    }
+    client->state = CLIENT_CONNECTING;
+    return 0;
+}
+
+void client_close(workerT *worker, clientT *client) {
+    if (client->fd >= 0) {
+        struct tcp_info info;
+        socklen_t len = sizeof(info);
+        if (getsockopt(client->fd, IPPROTO_TCP, TCP_INFO, &info, &len) == 0 &&
+            len >= offsetof(struct tcp_info, tcpi_data_segs_in) + sizeof(info.tcpi_data_segs_in)) {
+            worker->stats.segments += info.tcpi_data_segs_in;
+        }
+        epoll_ctl(worker->epfd, EPOLL_CTL_DEL, client->fd, NULL);
+        close(client->fd);
+        client->fd = -1;
+    }
+}
+
+// counts the error and starts over on a new connection
+void client_fail(workerT *worker, clientT *client) {
+    worker->stats.errors++;
+    client_close(worker, client);
+    client_start_request(worker, client);
+}
+
+// on a fresh connection the latency includes the connect
+void client_start_request(workerT *worker, clientT *client) {
+    client->target = pick_target(worker);
+    client->sent = 0;
+    client->headLen = 0;
+    client->headDone = false;
+    client->bodyLeft = 0;
+    client->serverCloses = false;
+    client->startNs = now_ns();
+
+    if (client->fd >= 0) {
+        client->state = CLIENT_SENDING;
+        if (client_send(worker, client) < 0) {
+            client_fail(worker, client);
+        }
+        return;
+    }
+    // a failed socket or connect is retried on the next wakeup instead of spinning
+    if (client_open(worker, client) < 0) {
+        worker->stats.errors++;
+    }
+}
+
+int client_send(workerT *worker, clientT *client) {
+    if (client->state == CLIENT_CONNECTING) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(client->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            return -1;
+        }
+        client->state = CLIENT_SENDING;
+    }
+
+    const targetT *target = client->target;
+    while (client->sent < target->requestLen) {
+        ssize_t n = send(client->fd, target->request + client->sent, target->requestLen - client->sent,
+                         MSG_NOSIGNAL);
+        if (n < 0 && errno == EAGAIN) {
+            struct epoll_event event = {.events = EPOLLOUT, .data.ptr = client};
+            return epoll_ctl(worker->epfd, EPOLL_CTL_MOD, client->fd, &event);
+        }
+        if (n < 0) {
+            return -1;
+        }
+        client->sent += n;
+    }
+
+    client->state = CLIENT_READING;
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = client};
+    return epoll_ctl(worker->epfd, EPOLL_CTL_MOD, client->fd, &event);
+}
+
+int client_read(workerT *worker, clientT *client) {
+    char body[65536];
+    while (true) {
+        char *buff = client->headDone ? body : client->head + client->headLen;
+        size_t room = client->headDone ? sizeof(body) : sizeof(client->head) - 1 - client->headLen;
+        if (room == 0) {
+            return -1;
+        }
+        ssize_t n = recv(client->fd, buff, room, 0);
+        if (n < 0 && errno == EAGAIN) {
+            return 0;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        worker->stats.bytes += n;
+
+        if (client->headDone) {
+            client->bodyLeft -= n;
+        } else {
+            client->headLen += n;
+            client->head[client->headLen] = '\0';
+            int rc = parse_head(client);
+            if (rc < 0) {
+                return -1;
+            }
+        }
+        if (client->headDone && client->bodyLeft <= 0) {
+            on_response(worker, client);
+            return 0;
+        }
+    }
+}
+
+// once the header block is complete: status, Content-Length and the body bytes already read
+int parse_head(clientT *client) {
+    char *end = strstr(client->head, "\r\n\r\n");
+    if (end == NULL) {
+        return 0;
+    }
+    size_t head_len = end + 4 - client->head;
+
+    int status = 0;
+    if (sscanf(client->head, "HTTP/1.%*d %d", &status) != 1) {
+        return -1;
+    }
+    long long content_len = 0;
+    bool closes = false;
+    for (char *line = strstr(client->head, "\r\n"); line != NULL && line < end; line = strstr(line + 2, "\r\n")) {
+        char *name = line + 2;
+        if (strncasecmp(name, "Content-Length:", sizeof("Content-Length:") - 1) == 0) {
+            content_len = atoll(name + sizeof("Content-Length:") - 1);
+        } else if (strncasecmp(name, "Connection: close", sizeof("Connection: close") - 1) == 0) {
+            closes = true;
+        }
+    }
+
+    client->headDone = true;
+    client->status = status;
+    client->serverCloses = closes;
+    client->bodyLeft = content_len - (long long) (client->headLen - head_len);
+    return 0;
+}
+
+void on_response(workerT *worker, clientT *client) {
+    statsT *stats = &worker->stats;
+    unsigned long long ns = (unsigned long long) (now_ns() - client->startNs);
+    stats->requests++;
+    stats->hist[bucket_index(ns)]++;
+    stats->sumNs += ns;
+    if (ns > stats->maxNs) {
+        stats->maxNs = ns;
+    }
+    if (client->status < 200 || client->status >= 400) {
+        stats->non2xx++;
+    }
+
+    if (!worker->scenario->keepAlive || client->serverCloses) {
+        client_close(worker, client);
+    }
+    client_start_request(worker, client);
+}
+
+// xorshift64*, weighted by the cumulative weights
+const targetT *pick_target(workerT *worker) {
+    scenarioT *scenario = worker->scenario;
+    worker->rng ^= worker->rng >> 12;
+    worker->rng ^= worker->rng << 25;
+    worker->rng ^= worker->rng >> 27;
+    unsigned pick = (unsigned) ((worker->rng * 2685821657736338717ull) >> 32) % scenario->totalWeight;
+    for (int i = 0; i < scenario->nTargets; ++i) {
+        if (pick < scenario->targets[i].weight) {
+            return &scenario->targets[i];
+        }
+        pick -= scenario->targets[i].weight;
+    }
+    return &scenario->targets[scenario->nTargets - 1];
+}
+
+int add_target(scenarioT *scenario, const char *url, unsigned weight) {
+    if (scenario->nTargets >= MAX_TARGETS || weight == 0) {
+        return -1;
+    }
+    targetT *target = &scenario->targets[scenario->nTargets];
+    int rc = snprintf(target->url, sizeof(target->url), "%s", url);
+    if (rc < 0 || (size_t) rc >= sizeof(target->url)) {
+        fprintf(stderr, "url too long: %s\n", url);
+        return -1;
+    }
+    scenario->nTargets++;
+    target->weight = weight;
+    scenario->totalWeight += weight;
+    return 0;
+}
+
+// comma separated urls, each optionally followed by =weight
+int parse_urls(scenarioT *scenario, const char *list) {
+    char *copy = strdup(list);
+    if (copy == NULL) {
+        return -1;
+    }
+    char *save = NULL;
+    for (char *item = strtok_r(copy, ",", &save); item != NULL; item = strtok_r(NULL, ",", &save)) {
+        unsigned weight = 1;
+        char *eq = strchr(item, '=');
+        if (eq != NULL) {
+            *eq = '\0';
+            weight = (unsigned) atoi(eq + 1);
+        }
+        if (add_target(scenario, item, weight) < 0) {
+            free(copy);
+            return -1;
+        }
+    }
+    free(copy);
+    return 0;
+}
+
+// every regular file under root with equal weight, precompressed sidecars left out
+int scan_root(scenarioT *scenario, const char *root) {
+    scan_scenario = scenario;
+    scan_root_len = strlen(root);
+    return nftw(root, collect_file, 16, FTW_PHYS);
+}
+
+int collect_file(const char *path, const struct stat *st, int type, struct FTW *ftw) {
+    (void) st;
+    (void) ftw;
+    size_t len = strlen(path);
+    if (type != FTW_F || (len > 3 && (strcmp(path + len - 3, ".br") == 0 || strcmp(path + len - 3, ".gz") == 0))) {
+        return 0;
+    }
+    const char *url = path + scan_root_len;
+    char buff[256];
+    snprintf(buff, sizeof(buff), "%s%s", *url == '/' ? "" : "/", url);
+    if (add_target(scan_scenario, buff, 1) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int run_scenario(scenarioT *scenario, statsT *total, double *elapsed) {
+    for (int i = 0; i < scenario->nTargets; ++i) {
+        targetT *target = &scenario->targets[i];
+        int rc = snprintf(target->request, sizeof(target->request),
+                          "GET %s HTTP/1.1\r\nHost: %s\r\nUser-Agent: bench\r\nAccept: */*\r\n%s\r\n",
+                          target->url, scenario->host,
+                          scenario->keepAlive ? "" : "Connection: close\r\n");
+        if (rc < 0 || (size_t) rc >= sizeof(target->request)) {
+            return -1;
+        }
+        target->requestLen = rc;
+    }
+
+    workerT *workers = calloc(scenario->threads, sizeof(workerT));
+    if (workers == NULL) {
+        return -1;
+    }
+    long long start = now_ns();
+    long long deadline = start + (long long) (scenario->seconds * 1e9);
+    for (int i = 0; i < scenario->threads; ++i) {
+        workerT *worker = &workers[i];
+        worker->scenario = scenario;
+        worker->nClients = scenario->conns / scenario->threads + (i < scenario->conns % scenario->threads);
+        worker->clients = calloc(worker->nClients > 0 ? worker->nClients : 1, sizeof(clientT));
+        worker->epfd = epoll_create1(EPOLL_CLOEXEC);
+        worker->rng = 0x9E3779B97F4A7C15ull * (i + 1);
+        worker->deadlineNs = deadline;
+        if (worker->clients == NULL || worker->epfd < 0 ||
+            pthread_create(&worker->thread, NULL, worker_routine, worker) != 0) {
+            perror("worker start");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    memset(total, 0, sizeof(*total));
+    for (int i = 0; i < scenario->threads; ++i) {
+        workerT *worker = &workers[i];
+        pthread_join(worker->thread, NULL);
+        statsT *stats = &worker->stats;
+        total->requests += stats->requests;
+        total->errors += stats->errors;
+        total->non2xx += stats->non2xx;
+        total->connects += stats->connects;
+        total->bytes += stats->bytes;
+        total->segments += stats->segments;
+        total->sumNs += stats->sumNs;
+        total->maxNs = stats->maxNs > total->maxNs ? stats->maxNs : total->maxNs;
+        for (int b = 0; b < HIST_BUCKETS; ++b) {
+            total->hist[b] += stats->hist[b];
+        }
+        close(worker->epfd);
+        free(worker->clients);
+    }
+    *elapsed = (double) (now_ns() - start) / 1e9;
+    free(workers);
+    return 0;
+}
+
+void print_json(scenarioT *scenario, const char *mode, statsT *stats, double elapsed) {
+    printf("{\"scenario\": \"%s\", \"server_mode\": \"%s\", \"connection\": \"%s\", \"threads\": %d, "
+           "\"connections\": %d, \"urls\": %d, \"duration_s\": %.3f, \"requests\": %llu, \"errors\": %llu, "
+           "\"non_2xx_3xx\": %llu, \"connects\": %llu, \"throughput_rps\": %.1f, \"throughput_mbps\": %.2f, "
+           "\"segments_per_request\": %.2f, "
+           "\"latency_us\": {\"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p999\": %.1f, "
+           "\"max\": %.1f}}",
+           scenario->name, mode != NULL ? mode : "external", scenario->keepAlive ? "keep-alive" : "close",
+           scenario->threads, scenario->conns, scenario->nTargets, elapsed, stats->requests, stats->errors,
+           stats->non2xx, stats->connects, (double) stats->requests / elapsed,
+           (double) stats->bytes * 8 / elapsed / 1e6,
+           stats->requests > 0 ? (double) stats->segments / (double) stats->requests : 0.0,
+           stats->requests > 0 ? (double) stats->sumNs / (double) stats->requests / 1e3 : 0.0,
+           percentile_us(stats, 0.5), percentile_us(stats, 0.9), percentile_us(stats, 0.99),
+           percentile_us(stats, 0.999), (double) stats->maxNs / 1e3);
+}
+
+// upper bound of the bucket holding the q-th sample, within 12.5%
+double percentile_us(statsT *stats, double q) {
+    if (stats->requests == 0) {
+        return 0.0;
+    }
+    unsigned long long rank = (unsigned long long) (q * (double) stats->requests);
+    unsigned long long seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+        seen += stats->hist[b];
+        if (seen > rank) {
+            unsigned long long limit = bucket_limit(b);
+            return (double) (limit < stats->maxNs ? limit : stats->maxNs) / 1e3;
+        }
+    }
+    return (double) stats->maxNs / 1e3;
+}
+
+int bucket_index(unsigned long long ns) {
+    if (ns >= 1ull << HIST_MAX_BITS) {
+        ns = (1ull << HIST_MAX_BITS) - 1;
+    }
+    if (ns < (1u << HIST_SUB_BITS)) {
+        return (int) ns;
+    }
+    int msb = 63 - __builtin_clzll(ns);
+    int octave = msb - HIST_SUB_BITS + 1;
+    return (octave << HIST_SUB_BITS) | (int) ((ns >> (msb - HIST_SUB_BITS)) & ((1u << HIST_SUB_BITS) - 1));
+}
+
+unsigned long long bucket_limit(int bucket) {
+    int octave = bucket >> HIST_SUB_BITS;
+    unsigned long long sub = bucket & ((1u << HIST_SUB_BITS) - 1);
+    if (octave == 0) {
+        return sub + 1;
+    }
+    return ((1ull << HIST_SUB_BITS) + sub + 1) << (octave - 1);
+}
+
+// the server runs from the current directory (it serves ./static), its output is discarded
+pid_t start_server(const char *path, const char *args, const char *mode, int port) {
+    char port_str[16];
+    snprintf(port_str, sizeof(port_str), "%d", port);
+    char *copy = strdup(args != NULL ? args : "");
+    if (copy == NULL) {
+        return -1;
+    }
+
+    char *argv[MAX_SERVER_ARGS + 6];
+    int argc = 0;
+    argv[argc++] = (char *) path;
+    argv[argc++] = "-p";
+    argv[argc++] = port_str;
+    if (mode != NULL) {
+        argv[argc++] = "-m";
+        argv[argc++] = (char *) mode;
+    }
+    char *save = NULL;
+    for (char *arg = strtok_r(copy, " ", &save); arg != NULL && argc < MAX_SERVER_ARGS + 5;
+         arg = strtok_r(NULL, " ", &save)) {
+        argv[argc++] = arg;
+    }
+    argv[argc] = NULL;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+        }
+        execv(path, argv);
+        _exit(127);
+    }
+    free(copy);
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+    if (wait_port(DEFAULT_HOST, port, SERVER_START_MS) < 0) {
+        fprintf(stderr, "server %s did not start listening on %d\n", path, port);
+        stop_server(pid);
+        return -1;
+    }
+    return pid;
+}
+
+void stop_server(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+int wait_port(const char *host, int port, int timeout_ms) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    inet_pton(AF_INET, host, &addr.sin_addr);
+    for (int waited = 0; waited < timeout_ms; waited += 20) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+            close(fd);
+            return 0;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        usleep(20000);
+    }
+    return -1;
+}
+
+long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    scenarioT scenario = {
+            .name = "custom",
+            .host = DEFAULT_HOST,
+            .port = DEFAULT_PORT,
+            .threads = DEFAULT_THREADS,
+            .conns = DEFAULT_CONNS,
+            .seconds = DEFAULT_SECONDS,
+            .keepAlive = true,
+    };
+    const char *urls = NULL;
+    const char *root = DEFAULT_ROOT;
+    const char *server = NULL;
+    const char *server_args = NULL;
+    bool matrix = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "H:p:t:c:d:Cu:r:S:a:xh")) != -1) {
+        switch (opt) {
+            case 'H':
+                scenario.host = optarg;
+                break;
+            case 'p':
+                scenario.port = atoi(optarg);
+                break;
+            case 't':
+                scenario.threads = atoi(optarg);
+                break;
+            case 'c':
+                scenario.conns = atoi(optarg);
+                break;
+            case 'd':
+                scenario.seconds = atof(optarg);
+                break;
+            case 'C':
+                scenario.keepAlive = false;
+                break;
+            case 'u':
+                urls = optarg;
+                break;
+            case 'r':
+                root = optarg;
+                break;
+            case 'S':
+                server = optarg;
+                break;
+            case 'a':
+                server_args = optarg;
+                break;
+            case 'x':
+                matrix = true;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-H host] [-p port] [-t threads] [-c connections] [-d seconds] [-C]\n"
+                                "       [-u url[=weight],...] [-r root] [-S server] [-a \"server args\"] [-x]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if (scenario.threads <= 0 || scenario.conns <= 0 || scenario.seconds <= 0) {
+        fprintf(stderr, "threads, connections and duration must be positive\n");
+        return EXIT_FAILURE;
+    }
+    if (matrix && server == NULL) {
+        fprintf(stderr, "the scenario matrix starts the server itself, pass its path with -S\n");
+        return EXIT_FAILURE;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    scenario.targets = calloc(MAX_TARGETS, sizeof(targetT));
+    if (scenario.targets == NULL) {
+        return EXIT_FAILURE;
+    }
+    int rc = urls != NULL ? parse_urls(&scenario, urls) : scan_root(&scenario, root);
+    if (rc < 0 || scenario.nTargets == 0) {
+        fprintf(stderr, "no urls to request (root %s)\n", root);
+        return EXIT_FAILURE;
+    }
+
+    statsT *stats = calloc(1, sizeof(statsT));
+    if (stats == NULL) {
+        return EXIT_FAILURE;
+    }
+    double elapsed;
+
+    if (!matrix) {
+        pid_t pid = server != NULL ? start_server(server, server_args, NULL, scenario.port) : 0;
+        if (pid < 0) {
+            return EXIT_FAILURE;
+        }
+        rc = run_scenario(&scenario, stats, &elapsed);
+        if (pid > 0) {
+            stop_server(pid);
+        }
+        if (rc < 0) {
+            return EXIT_FAILURE;
+        }
+        print_json(&scenario, server == NULL ? NULL : server_args != NULL ? server_args : "default", stats, elapsed);
+        printf("\n");
+        free(stats);
+        free(scenario.targets);
+        return EXIT_SUCCESS;
+    }
+
+    // the standard matrix: one server start per mode, then every connection mode and concurrency against it
+    const char *modes[] = {"pool", "reuseport", "uring"};
+    const bool keep_alive[] = {true, false};
+    const int conns[] = {1, 64, 256};
+    char name[64];
+    bool first = true;
+    printf("[\n");
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); ++m) {
+        pid_t pid = start_server(server, server_args, modes[m], scenario.port);
+        if (pid < 0) {
+            return EXIT_FAILURE;
+        }
+        for (size_t k = 0; k < sizeof(keep_alive) / sizeof(keep_alive[0]); ++k) {
+            for (size_t c = 0; c < sizeof(conns) / sizeof(conns[0]); ++c) {
+                snprintf(name, sizeof(name), "%s-%s-c%d", modes[m], keep_alive[k] ? "keepalive" : "close", conns[c]);
+                scenario.name = name;
+                scenario.keepAlive = keep_alive[k];
+                scenario.conns = conns[c];
+                if (run_scenario(&scenario, stats, &elapsed) < 0) {
+                    stop_server(pid);
+                    return EXIT_FAILURE;
+                }
+                printf("%s  ", first ? "" : ",\n");
+                print_json(&scenario, modes[m], stats, elapsed);
+                first = false;
+            }
+        }
+        stop_server(pid);
+    }
+    printf("\n]\n");
+
+    free(stats);
+    free(scenario.targets);
+    return EXIT_SUCCESS;
+}
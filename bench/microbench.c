@@ -0,0 +1,551 @@
+// Hot-path microbenchmarks: parse_req, get_content_type, the task queues, thread pool dispatch and the logger.
+// Every case is warmed up while its batch size is calibrated to SAMPLE_MS, then timed over SAMPLES batches;
+// the median per-op cost is reported in nanoseconds and TSC cycles (x86 only).
+// -o writes the results as JSON, -b compares them against such a file and fails on a regression.
+//
+// usage: microbench [-f filter] [-o results.json] [-b baseline.json] [-T tolerance %]
+
+#define _GNU_SOURCE
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+#include "../server/request.h"
+#include "../server/content_type.h"
+#include "../queue/queue.h"
+#include "../queue/ring.h"
+#include "../tpool/t_pool.h"
+#include "../log/log.h"
+
+#define SAMPLES 9
+#define SAMPLE_MS 10
+#define MAX_CASES 64
+#define NAME_LEN 64
+#define BUFF_SIZE 2048
+#define CONTENDED_THREADS 4
+#define DEFAULT_TOLERANCE 10.0
+
+typedef struct cost {
+    double ns;
+    double cycles;
+} costT;
+
+// runs iters operations and adds what they took to total
+typedef void (*benchFnT)(void *arg, long iters, costT *total);
+
+typedef struct benchCase {
+    char name[NAME_LEN];
+    benchFnT fn;
+    void *arg;
+
+    long iters;
+    costT median;
+    double minNs;
+} benchCaseT;
+
+typedef struct timer {
+    long long ns;
+    uint64_t cycles;
+} timerT;
+
+typedef struct contended {
+    int nThreads;
+    bool ring;
+    queueT *queue;
+    pthread_mutex_t mutex;
+    ringT *ringQueue;
+    pthread_barrier_t barrier;
+    long iters;
+} contendedT;
+
+typedef struct dispatch {
+    tPoolT *pool;
+    // stamped by the task when it starts
+    atomic_llong startedNs;
+    atomic_ullong startedCycles;
+} dispatchT;
+
+typedef struct logCase {
+    logLevelT level;
+    logLevelT enabled;
+} logCaseT;
+
+void bench_parse_req(void *arg, long iters, costT *total);
+
+void bench_content_type(void *arg, long iters, costT *total);
+
+void bench_queue(void *arg, long iters, costT *total);
+
+void *contended_routine(void *arg);
+
+void bench_dispatch(void *arg, long iters, costT *total);
+
+void dispatched_task(void *arg);
+
+void bench_log(void *arg, long iters, costT *total);
+
+void add_case(const char *name, benchFnT fn, void *arg);
+
+void run_case(benchCaseT *bench);
+
+int write_results(const char *path);
+
+int compare_baseline(const char *path, double tolerance);
+
+void timer_start(timerT *timer);
+
+void timer_stop(timerT *timer, costT *total);
+
+long long now_ns();
+
+uint64_t now_cycles();
+
+int cmp_cost(const void *a, const void *b);
+
+benchCaseT cases[MAX_CASES];
+int n_cases = 0;
+
+// keeps results alive so the measured calls are not optimised out
+volatile uintptr_t sink;
+
+const char *requests[] = {
+        "GET /img/workspaces.png HTTP/1.1\r\n"
+        "Host: localhost:8100\r\n"
+        "Connection: keep-alive\r\n"
+        "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+        "sec-ch-ua-mobile: ?0\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+        "Chrome/124.0.0.0 Safari/537.36\r\n"
+        "sec-ch-ua-platform: \"Linux\"\r\n"
+        "Accept: image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8\r\n"
+        "Sec-Fetch-Site: same-origin\r\n"
+        "Sec-Fetch-Mode: no-cors\r\n"
+        "Sec-Fetch-Dest: image\r\n"
+        "Referer: http://localhost:8100/\r\n"
+        "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "\r\n",
+
+        "GET /index.html HTTP/1.1\r\n"
+        "Host: localhost:8100\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Ubuntu; Linux x86_64; rv:125.0) Gecko/20100101 Firefox/125.0\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Language: en-US,en;q=0.5\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Connection: keep-alive\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "Sec-Fetch-Dest: document\r\n"
+        "Sec-Fetch-Mode: navigate\r\n"
+        "Sec-Fetch-Site: none\r\n"
+        "Sec-Fetch-User: ?1\r\n"
+        "If-Modified-Since: Sun, 24 Dec 2023 10:00:00 GMT\r\n"
+        "\r\n",
+
+        "GET /data.txt HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "User-Agent: curl/8.5.0\r\n"
+        "Accept: */*\r\n"
+        "\r\n",
+};
+
+const char *request_names[] = {"chrome", "firefox", "curl"};
+
+// each round starts from a fresh copy of the request, as after a read
+void bench_parse_req(void *arg, long iters, costT *total) {
+    const char *request = (const char *) arg;
+    size_t len = strlen(request) + 1;
+    char buff[BUFF_SIZE];
+    requestT req;
+
+    timerT timer;
+    timer_start(&timer);
+    for (long i = 0; i < iters; ++i) {
+        memcpy(buff, request, len);
+        sink += parse_req(&req, buff) + req.keepAlive;
+    }
+    timer_stop(&timer, total);
+}
+
+void bench_content_type(void *arg, long iters, costT *total) {
+    char *path = (char *) arg;
+
+    timerT timer;
+    timer_start(&timer);
+    for (long i = 0; i < iters; ++i) {
+        sink += (uintptr_t) get_content_type(path);
+    }
+    timer_stop(&timer, total);
+}
+
+// push + pop pairs from nThreads threads on one queueT behind a mutex, the way tPool used it, or on one ringT
+void bench_queue(void *arg, long iters, costT *total) {
+    contendedT *contended = (contendedT *) arg;
+    contended->iters = iters / contended->nThreads > 0 ? iters / contended->nThreads : 1;
+    pthread_t threads[CONTENDED_THREADS];
+    pthread_barrier_init(&contended->barrier, NULL, contended->nThreads + 1);
+    for (int i = 0; i < contended->nThreads; ++i) {
+        pthread_create(&threads[i], NULL, contended_routine, contended);
+    }
+
+    // thread start-up stays out of the measurement
+    timerT timer;
+    pthread_barrier_wait(&contended->barrier);
+    timer_start(&timer);
+    for (int i = 0; i < contended->nThreads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    timer_stop(&timer, total);
+    pthread_barrier_destroy(&contended->barrier);
+}
+
+void *contended_routine(void *arg) {
+    contendedT *contended = (contendedT *) arg;
+    taskT task = {.handler = NULL, .arg = NULL};
+    taskT out;
+    pthread_barrier_wait(&contended->barrier);
+
+    for (long i = 0; i < contended->iters; ++i) {
+        if (contended->ring) {
+            while (ringPush(contended->ringQueue, &task) != 0);
+            while (ringPop(contended->ringQueue, &out) != 0);
+            continue;
+        }
+        // queueT takes ownership of a heap task and frees it on pop
+        taskT *heap_task = calloc(1, sizeof(taskT));
+        pthread_mutex_lock(&contended->mutex);
+        queuePush(contended->queue, heap_task);
+        pthread_mutex_unlock(&contended->mutex);
+
+        pthread_mutex_lock(&contended->mutex);
+        int rc = queuePop(contended->queue, &out);
+        pthread_mutex_unlock(&contended->mutex);
+        sink += rc;
+    }
+    return NULL;
+}
+
+// latency from tPoolAddTask to the task starting on a worker, one task in flight at a time
+void bench_dispatch(void *arg, long iters, costT *total) {
+    dispatchT *dispatch = (dispatchT *) arg;
+    taskT task = {.handler = dispatched_task, .arg = dispatch};
+
+    for (long i = 0; i < iters; ++i) {
+        atomic_store(&dispatch->startedNs, 0);
+        long long start_ns = now_ns();
+        uint64_t start_cycles = now_cycles();
+        while (tPoolAddTask(dispatch->pool, &task) != 0);
+        long long started;
+        for (int spins = 1; (started = atomic_load(&dispatch->startedNs)) == 0; ++spins) {
+            // a worker sharing the only CPU needs it given up
+            if (spins % 1024 == 0) {
+                sched_yield();
+            } else {
+                cpuRelax();
+            }
+        }
+        total->ns += (double) (started - start_ns);
+        total->cycles += (double) (atomic_load(&dispatch->startedCycles) - start_cycles);
+    }
+}
+
+void dispatched_task(void *arg) {
+    dispatchT *dispatch = (dispatchT *) arg;
+    atomic_store(&dispatch->startedCycles, now_cycles());
+    atomic_store(&dispatch->startedNs, now_ns());
+}
+
+// the cost paid by the calling thread, formatting and the ring included; the flusher drains in the background
+void bench_log(void *arg, long iters, costT *total) {
+    logCaseT *log_case = (logCaseT *) arg;
+    logSetLevel(log_case->enabled);
+
+    timerT timer;
+    timer_start(&timer);
+    for (long i = 0; i < iters; ++i) {
+        switch (log_case->level) {
+            case ERROR:
+                logError(ERR_FSTR, "failed open file", "No such file or directory");
+                break;
+            case WARN:
+                logWarn("could not determine the file type");
+                break;
+            case INFO:
+                logInfo("%s", "successful response");
+                break;
+            case DEBUG:
+                logDebug("path: %s", "/root/static/img/card.png");
+                break;
+            default:
+                logTrace("request %ld", i);
+                break;
+        }
+    }
+    timer_stop(&timer, total);
+    logSetLevel(ERROR);
+}
+
+void add_case(const char *name, benchFnT fn, void *arg) {
+    if (n_cases >= MAX_CASES) {
+        return;
+    }
+    benchCaseT *bench = &cases[n_cases++];
+    snprintf(bench->name, sizeof(bench->name), "%s", name);
+    bench->fn = fn;
+    bench->arg = arg;
+}
+
+// doubling the batch until it takes SAMPLE_MS doubles as the warm-up
+void run_case(benchCaseT *bench) {
+    long iters = 1;
+    while (true) {
+        costT cost = {0};
+        bench->fn(bench->arg, iters, &cost);
+        if (cost.ns >= SAMPLE_MS * 1e6 || iters >= (1L << 40)) {
+            break;
+        }
+        iters *= 2;
+    }
+
+    costT samples[SAMPLES];
+    for (int i = 0; i < SAMPLES; ++i) {
+        costT cost = {0};
+        bench->fn(bench->arg, iters, &cost);
+        samples[i] = (costT) {cost.ns / (double) iters, cost.cycles / (double) iters};
+    }
+    qsort(samples, SAMPLES, sizeof(costT), cmp_cost);
+    bench->iters = iters;
+    bench->median = samples[SAMPLES / 2];
+    bench->minNs = samples[0].ns;
+}
+
+int write_results(const char *path) {
+    FILE *out = fopen(path, "w");
+    if (out == NULL) {
+        perror(path);
+        return -1;
+    }
+    fprintf(out, "[\n");
+    for (int i = 0; i < n_cases; ++i) {
+        benchCaseT *bench = &cases[i];
+        fprintf(out, "{\"name\": \"%s\", \"ns_per_op\": %.2f, \"cycles_per_op\": %.1f, \"min_ns_per_op\": %.2f, "
+                     "\"iterations\": %ld}%s\n", bench->name, bench->median.ns, bench->median.cycles, bench->minNs,
+                bench->iters, i + 1 < n_cases ? "," : "");
+    }
+    fprintf(out, "]\n");
+    return fclose(out);
+}
+
+// the baseline is a file written by -o, one case per line; returns the number of regressions
+int compare_baseline(const char *path, double tolerance) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+    printf("\n%-28s %12s %12s %9s\n", "baseline", "before (ns)", "now (ns)", "change");
+    int regressions = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), in) != NULL) {
+        char name[NAME_LEN];
+        double ns;
+        if (sscanf(line, " {\"name\": \"%63[^\"]\", \"ns_per_op\": %lf", name, &ns) != 2) {
+            continue;
+        }
+        for (int i = 0; i < n_cases; ++i) {
+            if (strcmp(cases[i].name, name) != 0) {
+                continue;
+            }
+            double change = (cases[i].median.ns - ns) / ns * 100;
+            bool regressed = change > tolerance;
+            regressions += regressed;
+            printf("%-28s %12.2f %12.2f %+8.1f%%%s\n", name, ns, cases[i].median.ns, change,
+                   regressed ? "  REGRESSION" : "");
+        }
+    }
+    fclose(in);
+    return regressions;
+}
+
+void timer_start(timerT *timer) {
+    timer->ns = now_ns();
+    timer->cycles = now_cycles();
+}
+
+void timer_stop(timerT *timer, costT *total) {
+    uint64_t cycles = now_cycles();
+    long long ns = now_ns();
+    total->ns += (double) (ns - timer->ns);
+    total->cycles += (double) (cycles - timer->cycles);
+}
+
+long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// fenced so the read is not reordered around the measured code
+uint64_t now_cycles() {
+#if HAVE_TSC
+    _mm_lfence();
+    uint64_t tsc = __rdtsc();
+    _mm_lfence();
+    return tsc;
+#else
+    return 0;
+#endif
+}
+
+int cmp_cost(const void *a, const void *b) {
+    double x = ((const costT *) a)->ns;
+    double y = ((const costT *) b)->ns;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    const char *filter = NULL;
+    const char *output = NULL;
+    const char *baseline = NULL;
+    double tolerance = DEFAULT_TOLERANCE;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:o:b:T:h")) != -1) {
+        switch (opt) {
+            case 'f':
+                filter = optarg;
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            case 'b':
+                baseline = optarg;
+                break;
+            case 'T':
+                tolerance = atof(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f filter] [-o results.json] [-b baseline.json] [-T tolerance %%]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    // the logger cases write through the real flusher, into /dev/null
+    if (logInit() < 0) {
+        return EXIT_FAILURE;
+    }
+    int null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (null_fd < 0) {
+        return EXIT_FAILURE;
+    }
+    logSetFd(null_fd);
+    logSetPolicy(LOG_BLOCK);
+    logSetLevel(ERROR);
+
+    char name[NAME_LEN];
+    for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); ++i) {
+        snprintf(name, sizeof(name), "parse_req/%s", request_names[i]);
+        add_case(name, bench_parse_req, (void *) requests[i]);
+    }
+
+    char paths[TYPE_NUM + 2][64];
+    for (int i = 0; i < TYPE_NUM; ++i) {
+        snprintf(paths[i], sizeof(paths[i]), "/srv/static/img/file.%s", TYPE_EXT[i]);
+        snprintf(name, sizeof(name), "content_type/%s", TYPE_EXT[i]);
+        add_case(name, bench_content_type, paths[i]);
+    }
+    snprintf(paths[TYPE_NUM], sizeof(paths[TYPE_NUM]), "/srv/static/archive.tar");
+    add_case("content_type/unknown", bench_content_type, paths[TYPE_NUM]);
+    snprintf(paths[TYPE_NUM + 1], sizeof(paths[TYPE_NUM + 1]), "/srv/static/LICENSE");
+    add_case("content_type/none", bench_content_type, paths[TYPE_NUM + 1]);
+
+    contendedT queues[2], rings[2];
+    const int threads[] = {1, CONTENDED_THREADS};
+    for (int i = 0; i < 2; ++i) {
+        queues[i] = (contendedT) {.nThreads = threads[i], .queue = queueNew()};
+        pthread_mutex_init(&queues[i].mutex, NULL);
+        snprintf(name, sizeof(name), "queue/push_pop_t%d", threads[i]);
+        add_case(name, bench_queue, &queues[i]);
+
+        rings[i] = (contendedT) {.nThreads = threads[i], .ring = true, .ringQueue = ringNew(1024)};
+        snprintf(name, sizeof(name), "ring/push_pop_t%d", threads[i]);
+        add_case(name, bench_queue, &rings[i]);
+    }
+
+    const tPoolSchedT scheds[] = {TPOOL_SHARED, TPOOL_ROUND_ROBIN};
+    dispatchT dispatches[2];
+    for (int i = 0; i < 2; ++i) {
+        dispatches[i].pool = tPoolNewSched(2, scheds[i]);
+        if (dispatches[i].pool == NULL || tPoolStart(dispatches[i].pool) != 0) {
+            return EXIT_FAILURE;
+        }
+        snprintf(name, sizeof(name), "tpool/dispatch_%s", tPoolSchedName(scheds[i]));
+        add_case(name, bench_dispatch, &dispatches[i]);
+    }
+
+    logCaseT log_cases[] = {
+            {ERROR, TRACE}, {WARN, TRACE}, {INFO, TRACE}, {DEBUG, TRACE}, {TRACE, TRACE},
+            // the common case in production: debug calls below the INFO level
+            {DEBUG, INFO},
+    };
+    const char *level_names[] = {"fatal", "error", "warn", "info", "debug", "trace"};
+    for (size_t i = 0; i < sizeof(log_cases) / sizeof(log_cases[0]); ++i) {
+        bool filtered = log_cases[i].level > log_cases[i].enabled;
+        snprintf(name, sizeof(name), "log/%s%s", level_names[log_cases[i].level], filtered ? "_filtered" : "");
+        add_case(name, bench_log, &log_cases[i]);
+    }
+
+    // a filter keeps the matching cases only
+    int kept = 0;
+    for (int i = 0; i < n_cases; ++i) {
+        if (filter == NULL || strstr(cases[i].name, filter) != NULL) {
+            cases[kept++] = cases[i];
+        }
+    }
+    n_cases = kept;
+
+    printf("%-28s %12s %12s %12s\n", "case", "ns/op", "cycles/op", "min ns/op");
+    for (int i = 0; i < n_cases; ++i) {
+        run_case(&cases[i]);
+        printf("%-28s %12.2f %12.1f %12.2f\n", cases[i].name, cases[i].median.ns, cases[i].median.cycles,
+               cases[i].minNs);
+    }
+
+    int rc = EXIT_SUCCESS;
+    if (output != NULL && write_results(output) != 0) {
+        rc = EXIT_FAILURE;
+    }
+    if (baseline != NULL) {
+        int regressions = compare_baseline(baseline, tolerance);
+        if (regressions != 0) {
+            fprintf(stderr, "%d regression(s) beyond %.1f%%\n", regressions < 0 ? 0 : regressions, tolerance);
+            rc = EXIT_FAILURE;
+        }
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        tPoolStop(dispatches[i].pool);
+        tPoolFree(dispatches[i].pool);
+        pthread_mutex_destroy(&queues[i].mutex);
+        queueFree(queues[i].queue);
+        ringFree(rings[i].ringQueue);
+    }
+    logFree();
+    return rc;
+}
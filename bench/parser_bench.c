@@ -0,0 +1,209 @@
+// Request parser microbenchmark: the old strtok_r based parse_req against the
+// incremental parser on realistic browser requests.
+//
+// usage: parser_bench [iterations]
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "../server/request.h"
+#include "../log/log.h"
+
+#define DEFAULT_ITERATIONS 1000000
+#define BUFF_SIZE 2048
+
+typedef struct legacyRequest {
+    request_method_t method;
+    char url[URL_LEN];
+    http_version_t version;
+    bool keepAlive;
+} legacyRequestT;
+
+const char *requests[] = {
+        "GET /img/workspaces.png HTTP/1.1\r\n"
+        "Host: localhost:8100\r\n"
+        "Connection: keep-alive\r\n"
+        "sec-ch-ua: \"Chromium\";v=\"124\", \"Google Chrome\";v=\"124\", \"Not-A.Brand\";v=\"99\"\r\n"
+        "sec-ch-ua-mobile: ?0\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+        "Chrome/124.0.0.0 Safari/537.36\r\n"
+        "sec-ch-ua-platform: \"Linux\"\r\n"
+        "Accept: image/avif,image/webp,image/apng,image/svg+xml,image/*,*/*;q=0.8\r\n"
+        "Sec-Fetch-Site: same-origin\r\n"
+        "Sec-Fetch-Mode: no-cors\r\n"
+        "Sec-Fetch-Dest: image\r\n"
+        "Referer: http://localhost:8100/\r\n"
+        "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "\r\n",
+
+        "GET /index.html HTTP/1.1\r\n"
+        "Host: localhost:8100\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Ubuntu; Linux x86_64; rv:125.0) Gecko/20100101 Firefox/125.0\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Language: en-US,en;q=0.5\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Connection: keep-alive\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "Sec-Fetch-Dest: document\r\n"
+        "Sec-Fetch-Mode: navigate\r\n"
+        "Sec-Fetch-Site: none\r\n"
+        "Sec-Fetch-User: ?1\r\n"
+        "If-Modified-Since: Sun, 24 Dec 2023 10:00:00 GMT\r\n"
+        "\r\n",
+
+        "GET /data.txt HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "User-Agent: curl/8.5.0\r\n"
+        "Accept: */*\r\n"
+        "\r\n",
+};
+
+int legacy_parse_req(legacyRequestT *req, char *buff);
+
+bool legacy_has_token(const char *value, const char *token);
+
+double now_sec();
+
+// parse_req as it was before the incremental parser
+int legacy_parse_req(legacyRequestT *req, char *buff) {
+    char *line_save = NULL;
+    char *saveptr = NULL;
+    req->version = HTTP10;
+    req->keepAlive = false;
+
+    char *http_query = strtok_r(buff, "\n", &line_save);
+    if (http_query == NULL) {
+        return -1;
+    }
+    logInfo("%s", http_query);
+
+    char *http_method = strtok_r(http_query, " ", &saveptr);
+    if (http_method == NULL) {
+        return -1;
+    }
+    req->method = strcmp(GET_STR, http_method) == 0 ? GET : strcmp(HEAD_STR, http_method) == 0 ? HEAD : BAD;
+    if (req->method == BAD) {
+        return 0;
+    }
+
+    char *http_url = strtok_r(NULL, " ", &saveptr);
+    if (http_url == NULL) {
+        return -1;
+    }
+    if (strcmp(http_url, "/") == 0)
+        strcpy(req->url, "index.html");
+    else
+        strcpy(req->url, http_url + 1);
+
+    char *http_version = strtok_r(NULL, "\r", &saveptr);
+    if (http_version == NULL) {
+        return -1;
+    }
+    if (strcmp(HTTP11_STR, http_version) != 0 && strcmp(HTTP10_STR, http_version) != 0) {
+        return -1;
+    }
+    req->version = strcmp(HTTP11_STR, http_version) == 0 ? HTTP11 : HTTP10;
+    req->keepAlive = req->version == HTTP11;
+
+    char *line;
+    while ((line = strtok_r(NULL, "\n", &line_save)) != NULL) {
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\r') {
+            line[--len] = '\0';
+        }
+        if (len == 0) {
+            break;
+        }
+
+        char *value = strchr(line, ':');
+        if (value == NULL) {
+            continue;
+        }
+        *value++ = '\0';
+        while (*value == ' ' || *value == '\t') {
+            value++;
+        }
+        if (strcasecmp(line, CONNECTION_HDR) == 0) {
+            if (legacy_has_token(value, "close")) {
+                req->keepAlive = false;
+            } else if (legacy_has_token(value, "keep-alive")) {
+                req->keepAlive = true;
+            }
+        }
+    }
+    return 0;
+}
+
+bool legacy_has_token(const char *value, const char *token) {
+    size_t token_len = strlen(token);
+    while (*value) {
+        while (*value == ' ' || *value == '\t' || *value == ',') {
+            value++;
+        }
+        size_t len = strcspn(value, ", \t");
+        if (len == token_len && strncasecmp(value, token, len) == 0) {
+            return true;
+        }
+        value += len;
+    }
+    return false;
+}
+
+double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    if (logInit() < 0) {
+        return EXIT_FAILURE;
+    }
+    logSetLevel(ERROR);
+
+    long iterations = argc > 1 ? atol(argv[1]) : DEFAULT_ITERATIONS;
+    if (iterations <= 0) {
+        return EXIT_FAILURE;
+    }
+
+    // both parsers write into the buffer, so each round starts from a fresh copy
+    char buff[BUFF_SIZE];
+    printf("%-8s %6s %16s %16s %8s\n", "request", "bytes", "parse_req (ns)", "parser (ns)", "speedup");
+    for (size_t i = 0; i < sizeof(requests) / sizeof(requests[0]); ++i) {
+        size_t len = strlen(requests[i]);
+        long failures = 0;
+
+        double start = now_sec();
+        for (long n = 0; n < iterations; ++n) {
+            legacyRequestT req;
+            memcpy(buff, requests[i], len + 1);
+            failures += legacy_parse_req(&req, buff) != 0 || !req.keepAlive;
+        }
+        double legacy = (now_sec() - start) / (double) iterations * 1e9;
+
+        start = now_sec();
+        for (long n = 0; n < iterations; ++n) {
+            requestT req;
+            httpParserT parser;
+            memcpy(buff, requests[i], len + 1);
+            parserInit(&parser);
+            failures += parserFeed(&parser, &req, buff, len) != PARSE_DONE || !req.keepAlive;
+        }
+        double parser = (now_sec() - start) / (double) iterations * 1e9;
+
+        if (failures > 0) {
+            fprintf(stderr, "request %zu: %ld parse failures\n", i, failures);
+            return EXIT_FAILURE;
+        }
+        printf("%-8zu %6zu %16.1f %16.1f %7.2fx\n", i, len, legacy, parser, legacy / parser);
+    }
+
+    logFree();
+    return EXIT_SUCCESS;
+}
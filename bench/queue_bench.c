@@ -0,0 +1,179 @@
+// Task queue microbenchmark: mutex + semaphore linked list (queueT)
+// against the lock-free ring (ringT) with N producers and N consumers.
+//
+// usage: queue_bench [tasks per producer]
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../queue/queue.h"
+#include "../queue/ring.h"
+#include "../log/log.h"
+
+#define DEFAULT_TASKS 200000
+#define MAX_THREADS 16
+
+typedef struct bench {
+    // old tPool queue
+    queueT *queue;
+    pthread_mutex_t qMutex;
+    sem_t sem;
+
+    ringT *ring;
+    atomic_bool stopping;
+
+    long tasksPerProducer;
+    atomic_long done;
+} benchT;
+
+void count_task(void *arg);
+
+void *list_producer(void *arg);
+
+void *list_consumer(void *arg);
+
+void *ring_producer(void *arg);
+
+void *ring_consumer(void *arg);
+
+double run(benchT *bench, int n, void *(*producer)(void *), void *(*consumer)(void *));
+
+double now_sec();
+
+void count_task(void *arg) {
+    atomic_fetch_add_explicit((atomic_long *) arg, 1, memory_order_relaxed);
+}
+
+void *list_producer(void *arg) {
+    benchT *bench = (benchT *) arg;
+    for (long i = 0; i < bench->tasksPerProducer; ++i) {
+        taskT *task = calloc(1, sizeof(taskT));
+        task->handler = count_task;
+        task->arg = &bench->done;
+
+        pthread_mutex_lock(&bench->qMutex);
+        queuePush(bench->queue, task);
+        sem_post(&bench->sem);
+        pthread_mutex_unlock(&bench->qMutex);
+    }
+    return NULL;
+}
+
+void *list_consumer(void *arg) {
+    benchT *bench = (benchT *) arg;
+    taskT task;
+    while (true) {
+        sem_wait(&bench->sem);
+        if (atomic_load(&bench->stopping)) {
+            break;
+        }
+
+        pthread_mutex_lock(&bench->qMutex);
+        int rc = queuePop(bench->queue, &task);
+        pthread_mutex_unlock(&bench->qMutex);
+
+        if (rc == 0) {
+            task.handler(task.arg);
+        }
+    }
+    return NULL;
+}
+
+void *ring_producer(void *arg) {
+    benchT *bench = (benchT *) arg;
+    taskT task = {.handler = count_task, .arg = &bench->done};
+    for (long i = 0; i < bench->tasksPerProducer; ++i) {
+        while (ringPush(bench->ring, &task) != 0) {
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+void *ring_consumer(void *arg) {
+    benchT *bench = (benchT *) arg;
+    taskT task;
+    while (ringPopWait(bench->ring, &task, &bench->stopping) == 0) {
+        task.handler(task.arg);
+    }
+    return NULL;
+}
+
+// returns tasks per second
+double run(benchT *bench, int n, void *(*producer)(void *), void *(*consumer)(void *)) {
+    pthread_t producers[MAX_THREADS], consumers[MAX_THREADS];
+    long total = bench->tasksPerProducer * n;
+    atomic_store(&bench->done, 0);
+    atomic_store(&bench->stopping, false);
+
+    double start = now_sec();
+    for (int i = 0; i < n; ++i) {
+        pthread_create(&consumers[i], NULL, consumer, bench);
+    }
+    for (int i = 0; i < n; ++i) {
+        pthread_create(&producers[i], NULL, producer, bench);
+    }
+    for (int i = 0; i < n; ++i) {
+        pthread_join(producers[i], NULL);
+    }
+    while (atomic_load(&bench->done) < total) {
+        sched_yield();
+    }
+    double elapsed = now_sec() - start;
+
+    atomic_store(&bench->stopping, true);
+    for (int i = 0; i < n; ++i) {
+        sem_post(&bench->sem);
+    }
+    ringWakeAll(bench->ring);
+    for (int i = 0; i < n; ++i) {
+        pthread_join(consumers[i], NULL);
+    }
+
+    return (double) total / elapsed;
+}
+
+double now_sec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    if (logInit() < 0) {
+        return EXIT_FAILURE;
+    }
+    logSetLevel(ERROR);
+
+    benchT bench = {0};
+    bench.tasksPerProducer = argc > 1 ? atol(argv[1]) : DEFAULT_TASKS;
+    bench.queue = queueNew();
+    bench.ring = ringNew(65536);
+    if (bench.queue == NULL || bench.ring == NULL || bench.tasksPerProducer <= 0) {
+        return EXIT_FAILURE;
+    }
+    pthread_mutex_init(&bench.qMutex, NULL);
+    sem_init(&bench.sem, 0, 0);
+
+    const int threads[] = {1, 4, 8, 16};
+    printf("%-8s %16s %16s %8s\n", "threads", "queueT (ops/s)", "ringT (ops/s)", "speedup");
+    for (size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); ++i) {
+        int n = threads[i];
+        double list = run(&bench, n, list_producer, list_consumer);
+        double ring = run(&bench, n, ring_producer, ring_consumer);
+        printf("%-8d %16.0f %16.0f %7.2fx\n", n, list, ring, ring / list);
+    }
+
+    sem_destroy(&bench.sem);
+    pthread_mutex_destroy(&bench.qMutex);
+    ringFree(bench.ring);
+    queueFree(bench.queue);
+    logFree();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,303 @@
+#include "content_cache.h"
+#include "hash.h"
+
+#define BUCKETS_NUM 4096
+#define RING_INIT_CAP 256
+#define SKETCH_MAX 15
+#define SKETCH_RESET (SKETCH_WIDTH * 10)
+
+static const uint32_t sketch_seeds[SKETCH_DEPTH] = {0x9e3779b1u, 0x85ebca77u, 0xc2b2ae3du, 0x27d4eb2fu};
+
+size_t entry_cost(cacheEntryT *entry);
+
+cacheEntryT *find_entry(contentCacheT *cache, const char *key, uint32_t hash);
+
+void unlink_entry(contentCacheT *cache, cacheEntryT *entry);
+
+bool evict_one(contentCacheT *cache);
+
+void free_entry(cacheEntryT *entry);
+
+int sketch_estimate(contentCacheT *cache, uint32_t hash);
+
+void sketch_increment(contentCacheT *cache, uint32_t hash);
+
+contentCacheT *contentCacheNew(size_t budget, size_t maxObject, int admitHits) {
+    contentCacheT *cache = calloc(1, sizeof(contentCacheT));
+    if (cache == NULL) {
+        logFatal(ERR_FSTR, "content cache alloc failed", strerror(errno));
+        return NULL;
+    }
+
+    cache->nBuckets = BUCKETS_NUM;
+    cache->buckets = calloc(cache->nBuckets, sizeof(cacheEntryT *));
+    cache->ringCap = RING_INIT_CAP;
+    cache->ring = calloc(cache->ringCap, sizeof(cacheEntryT *));
+    if (cache->buckets == NULL || cache->ring == NULL) {
+        logFatal(ERR_FSTR, "content cache tables alloc failed", strerror(errno));
+        free(cache->buckets);
+        free(cache->ring);
+        free(cache);
+        return NULL;
+    }
+
+    cache->budget = budget;
+    cache->maxObject = maxObject;
+    cache->admitHits = admitHits;
+    pthread_rwlock_init(&cache->lock, NULL);
+
+    return cache;
+}
+
+void contentCacheFree(contentCacheT *cache) {
+    for (long i = 0; i < cache->ringLen; ++i) {
+        contentCacheRelease(cache->ring[i]);
+    }
+    pthread_rwlock_destroy(&cache->lock);
+    free(cache->ring);
+    free(cache->buckets);
+    free(cache);
+}
+
+cacheEntryT *cacheEntryNew(const char *key, size_t headersLen, size_t bodyLen) {
+    cacheEntryT *entry = calloc(1, sizeof(cacheEntryT));
+    if (entry == NULL) {
+        logError(ERR_FSTR, "cache entry alloc failed", strerror(errno));
+        return NULL;
+    }
+
+    entry->key = strdup(key);
+    entry->headers = malloc(headersLen + 1);
+    entry->body = malloc(bodyLen > 0 ? bodyLen : 1);
+    if (entry->key == NULL || entry->headers == NULL || entry->body == NULL) {
+        logError(ERR_FSTR, "cache entry buffers alloc failed", strerror(errno));
+        free_entry(entry);
+        return NULL;
+    }
+
+    entry->hash = cacheHash(key);
+    entry->headersLen = headersLen;
+    entry->bodyLen = bodyLen;
+    entry->slot = -1;
+    atomic_init(&entry->refs, 1);
+    return entry;
+}
+
+// returns a referenced entry or NULL, every hit must be paired with contentCacheRelease
+cacheEntryT *contentCacheGet(contentCacheT *cache, const char *key) {
+    uint32_t hash = cacheHash(key);
+
+    pthread_rwlock_rdlock(&cache->lock);
+    // ===== CRITICAL SECTION =====
+    cacheEntryT *entry = find_entry(cache, key, hash);
+    if (entry != NULL) {
+        atomic_fetch_add(&entry->refs, 1);
+        atomic_store_explicit(&entry->referenced, true, memory_order_relaxed);
+    }
+    // ============================
+    pthread_rwlock_unlock(&cache->lock);
+
+    if (entry != NULL) {
+        atomic_fetch_add_explicit(&cache->hits, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&cache->misses, 1, memory_order_relaxed);
+        sketch_increment(cache, hash);
+    }
+    return entry;
+}
+
+// admission policy: the object must fit the size limits and be requested often enough
+bool contentCacheAdmit(contentCacheT *cache, const char *key, size_t size) {
+    bool admit = size <= cache->maxObject && size <= cache->budget &&
+                 sketch_estimate(cache, cacheHash(key)) >= cache->admitHits;
+
+    if (admit) {
+        atomic_fetch_add_explicit(&cache->admissions, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&cache->rejections, 1, memory_order_relaxed);
+    }
+    return admit;
+}
+
+// inserts entry (the caller keeps its own reference), replacing an older version of the key;
+// stale is checked under the lock so the source invalidating concurrently can't leave an orphan
+cacheEntryT *contentCachePut(contentCacheT *cache, cacheEntryT *entry, atomic_bool *stale) {
+    size_t cost = entry_cost(entry);
+    if (cost > cache->budget) {
+        return entry;
+    }
+
+    pthread_rwlock_wrlock(&cache->lock);
+    // ===== CRITICAL SECTION =====
+    if (stale != NULL && atomic_load(stale)) {
+        pthread_rwlock_unlock(&cache->lock);
+        return entry;
+    }
+
+    cacheEntryT *old = find_entry(cache, entry->key, entry->hash);
+    if (old != NULL) {
+        unlink_entry(cache, old);
+    }
+
+    while (cache->used + cost > cache->budget && evict_one(cache));
+
+    if (cache->ringLen == cache->ringCap) {
+        cacheEntryT **ring = realloc(cache->ring, cache->ringCap * 2 * sizeof(cacheEntryT *));
+        if (ring == NULL) {
+            pthread_rwlock_unlock(&cache->lock);
+            logError(ERR_FSTR, "cache ring realloc failed", strerror(errno));
+            return entry;
+        }
+        cache->ring = ring;
+        cache->ringCap *= 2;
+    }
+
+    atomic_fetch_add(&entry->refs, 1);
+    size_t bucket = entry->hash % cache->nBuckets;
+    entry->next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+    entry->slot = cache->ringLen;
+    cache->ring[cache->ringLen++] = entry;
+    cache->used += cost;
+    size_t used = cache->used;
+    // ============================
+    pthread_rwlock_unlock(&cache->lock);
+
+    // the key is immutable and the caller's reference keeps the entry alive
+    logDebug("cached %s (%zu bytes, used %zu of %zu)", entry->key, cost, used, cache->budget);
+    return entry;
+}
+
+void contentCacheRemove(contentCacheT *cache, cacheEntryT *entry) {
+    pthread_rwlock_wrlock(&cache->lock);
+    // ===== CRITICAL SECTION =====
+    if (!entry->removed) {
+        unlink_entry(cache, entry);
+    }
+    // ============================
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+void contentCacheRemoveKey(contentCacheT *cache, const char *key) {
+    uint32_t hash = cacheHash(key);
+
+    pthread_rwlock_wrlock(&cache->lock);
+    // ===== CRITICAL SECTION =====
+    cacheEntryT *entry = find_entry(cache, key, hash);
+    if (entry != NULL) {
+        unlink_entry(cache, entry);
+    }
+    // ============================
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+void contentCacheClear(contentCacheT *cache) {
+    pthread_rwlock_wrlock(&cache->lock);
+    // ===== CRITICAL SECTION =====
+    while (cache->ringLen > 0) {
+        unlink_entry(cache, cache->ring[cache->ringLen - 1]);
+    }
+    // ============================
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+void contentCacheRelease(cacheEntryT *entry) {
+    if (atomic_fetch_sub(&entry->refs, 1) == 1) {
+        free_entry(entry);
+    }
+}
+
+void contentCacheLogStats(contentCacheT *cache) {
+    logInfo("content cache: hits %llu, misses %llu, admitted %llu, rejected %llu, evicted %llu, used %zu bytes",
+            atomic_load(&cache->hits), atomic_load(&cache->misses), atomic_load(&cache->admissions),
+            atomic_load(&cache->rejections), atomic_load(&cache->evictions), cache->used);
+}
+
+size_t entry_cost(cacheEntryT *entry) {
+    return entry->headersLen + entry->bodyLen + strlen(entry->key);
+}
+
+cacheEntryT *find_entry(contentCacheT *cache, const char *key, uint32_t hash) {
+    cacheEntryT *entry = cache->buckets[hash % cache->nBuckets];
+    while (entry != NULL && (entry->hash != hash || strcmp(entry->key, key) != 0)) {
+        entry = entry->next;
+    }
+    return entry;
+}
+
+// must be called under the write lock, drops the reference held by the cache
+void unlink_entry(contentCacheT *cache, cacheEntryT *entry) {
+    cacheEntryT **link = &cache->buckets[entry->hash % cache->nBuckets];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+
+    cacheEntryT *last = cache->ring[--cache->ringLen];
+    cache->ring[entry->slot] = last;
+    last->slot = entry->slot;
+    if (cache->hand >= cache->ringLen) {
+        cache->hand = 0;
+    }
+
+    cache->used -= entry_cost(entry);
+    entry->removed = true;
+    contentCacheRelease(entry);
+}
+
+// CLOCK: skip and clear recently referenced entries, evict the first cold one
+bool evict_one(contentCacheT *cache) {
+    while (cache->ringLen > 0) {
+        cacheEntryT *entry = cache->ring[cache->hand];
+        if (atomic_exchange_explicit(&entry->referenced, false, memory_order_relaxed)) {
+            cache->hand = (cache->hand + 1) % cache->ringLen;
+            continue;
+        }
+
+        logDebug("evicted %s", entry->key);
+        unlink_entry(cache, entry);
+        atomic_fetch_add_explicit(&cache->evictions, 1, memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void free_entry(cacheEntryT *entry) {
+    free(entry->key);
+    free(entry->headers);
+    free(entry->body);
+    free(entry);
+}
+
+int sketch_estimate(contentCacheT *cache, uint32_t hash) {
+    int min = SKETCH_MAX;
+    for (int i = 0; i < SKETCH_DEPTH; ++i) {
+        uint32_t idx = (hash * sketch_seeds[i]) >> 20;
+        int cnt = atomic_load_explicit(&cache->sketch[i][idx], memory_order_relaxed);
+        if (cnt < min) {
+            min = cnt;
+        }
+    }
+    return min;
+}
+
+void sketch_increment(contentCacheT *cache, uint32_t hash) {
+    for (int i = 0; i < SKETCH_DEPTH; ++i) {
+        uint32_t idx = (hash * sketch_seeds[i]) >> 20;
+        unsigned char cnt = atomic_load_explicit(&cache->sketch[i][idx], memory_order_relaxed);
+        if (cnt < SKETCH_MAX) {
+            atomic_store_explicit(&cache->sketch[i][idx], cnt + 1, memory_order_relaxed);
+        }
+    }
+
+    // aging: halve all counters periodically so old popularity fades out
+    if (atomic_fetch_add_explicit(&cache->sketchAdds, 1, memory_order_relaxed) + 1 == SKETCH_RESET) {
+        atomic_store_explicit(&cache->sketchAdds, 0, memory_order_relaxed);
+        for (int i = 0; i < SKETCH_DEPTH; ++i) {
+            for (int j = 0; j < SKETCH_WIDTH; ++j) {
+                unsigned char cnt = atomic_load_explicit(&cache->sketch[i][j], memory_order_relaxed);
+                atomic_store_explicit(&cache->sketch[i][j], cnt >> 1, memory_order_relaxed);
+            }
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include "../log/log.h"
+#include "validator.h"
+
+#define SKETCH_DEPTH 4
+#define SKETCH_WIDTH 4096
+
+typedef struct cacheEntry cacheEntryT;
+
+struct cacheEntry {
+    char *key;
+    uint32_t hash;
+
+    // pre-rendered header block without Connection header and final CRLF
+    char *headers;
+    size_t headersLen;
+    char *body;
+    size_t bodyLen;
+    // static string, needed to render partial responses
+    const char *mime;
+
+    // file version the entry was built from
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    validatorT validator;
+    atomic_llong checkedAt;
+
+    atomic_int refs;
+    atomic_bool referenced;
+    bool removed;
+    long slot;
+
+    cacheEntryT *next;
+};
+
+typedef struct contentCache {
+    pthread_rwlock_t lock;
+
+    cacheEntryT **buckets;
+    size_t nBuckets;
+
+    // CLOCK ring
+    cacheEntryT **ring;
+    long ringLen, ringCap, hand;
+
+    size_t budget;
+    size_t used;
+    size_t maxObject;
+
+    // TinyLFU-style frequency sketch used as admission doorkeeper
+    atomic_uchar sketch[SKETCH_DEPTH][SKETCH_WIDTH];
+    atomic_uint sketchAdds;
+    int admitHits;
+
+    atomic_ullong hits, misses, admissions, rejections, evictions;
+} contentCacheT;
+
+contentCacheT *contentCacheNew(size_t budget, size_t maxObject, int admitHits);
+
+void contentCacheFree(contentCacheT *cache);
+
+cacheEntryT *contentCacheGet(contentCacheT *cache, const char *key);
+
+bool contentCacheAdmit(contentCacheT *cache, const char *key, size_t size);
+
+cacheEntryT *contentCachePut(contentCacheT *cache, cacheEntryT *entry, atomic_bool *stale);
+
+void contentCacheRemove(contentCacheT *cache, cacheEntryT *entry);
+
+void contentCacheRemoveKey(contentCacheT *cache, const char *key);
+
+void contentCacheClear(contentCacheT *cache);
+
+void contentCacheRelease(cacheEntryT *entry);
+
+cacheEntryT *cacheEntryNew(const char *key, size_t headersLen, size_t bodyLen);
+
+void contentCacheLogStats(contentCacheT *cache);
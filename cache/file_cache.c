@@ -0,0 +1,412 @@
+#include "file_cache.h"
+#include "hash.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <sys/inotify.h>
+
+#define FILE_BUCKETS_NUM 4096
+#define WATCH_MASK (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | \
+                    IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+#define INOTIFY_BUF_SIZE (64 * (sizeof(struct inotify_event) + NAME_MAX + 1))
+
+fileEntryT *find_file(fileCacheT *cache, const char *key, uint32_t hash);
+
+void unlink_file(fileCacheT *cache, fileEntryT *entry);
+
+void free_file(fileEntryT *entry);
+
+void invalidate_path(fileCacheT *cache, const char *path);
+
+void invalidate_all(fileCacheT *cache);
+
+int watch_tree(fileCacheT *cache, const char *dir);
+
+void *watch_routine(void *arg);
+
+void handle_event(fileCacheT *cache, struct inotify_event *event);
+
+fileCacheT *fileCacheNew(const char *root, size_t maxEntries) {
+    fileCacheT *cache = calloc(1, sizeof(fileCacheT));
+    if (cache == NULL) {
+        logFatal(ERR_FSTR, "file cache alloc failed", strerror(errno));
+        return NULL;
+    }
+
+    cache->nBuckets = FILE_BUCKETS_NUM;
+    cache->buckets = calloc(cache->nBuckets, sizeof(fileEntryT *));
+    cache->pathBuckets = calloc(cache->nBuckets, sizeof(fileEntryT *));
+    cache->root = strdup(root);
+    if (cache->buckets == NULL || cache->pathBuckets == NULL || cache->root == NULL) {
+        logFatal(ERR_FSTR, "file cache tables alloc failed", strerror(errno));
+        free(cache->buckets);
+        free(cache->pathBuckets);
+        free(cache->root);
+        free(cache);
+        return NULL;
+    }
+
+    cache->maxEntries = maxEntries;
+    cache->inotifyFd = -1;
+    pthread_rwlock_init(&cache->lock, NULL);
+
+    return cache;
+}
+
+void fileCacheFree(fileCacheT *cache) {
+    if (cache->watching) {
+        pthread_cancel(cache->watcher);
+        pthread_join(cache->watcher, NULL);
+    }
+    if (cache->inotifyFd >= 0) {
+        close(cache->inotifyFd);
+    }
+
+    while (cache->fifoHead != NULL) {
+        unlink_file(cache, cache->fifoHead);
+    }
+    for (int i = 0; i < cache->nWatchDirs; ++i) {
+        free(cache->watchDirs[i]);
+    }
+    free(cache->watchDirs);
+
+    pthread_rwlock_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache->pathBuckets);
+    free(cache->root);
+    free(cache);
+}
+
+// watches the root tree, without inotify entries could go stale so the cache refuses to work
+int fileCacheStart(fileCacheT *cache) {
+    cache->inotifyFd = inotify_init1(IN_CLOEXEC);
+    if (cache->inotifyFd < 0) {
+        logError(ERR_FSTR, "inotify_init1 failed", strerror(errno));
+        return -1;
+    }
+
+    if (watch_tree(cache, cache->root) < 0) {
+        return -1;
+    }
+
+    if (pthread_create(&cache->watcher, NULL, watch_routine, cache) != 0) {
+        logError(ERR_FSTR, "failed to create inotify thread", strerror(errno));
+        return -1;
+    }
+    cache->watching = true;
+
+    logInfo("file cache watching %s", cache->root);
+    return 0;
+}
+
+void fileCacheSetListener(fileCacheT *cache, fileListenerT listener, void *arg) {
+    cache->listener = listener;
+    cache->listenerArg = arg;
+}
+
+fileEntryT *fileEntryNew(const char *key, const char *path, int fd, struct stat *st, const char *mime) {
+    fileEntryT *entry = calloc(1, sizeof(fileEntryT));
+    if (entry == NULL) {
+        logError(ERR_FSTR, "file entry alloc failed", strerror(errno));
+        return NULL;
+    }
+
+    entry->key = strdup(key);
+    entry->path = strdup(path);
+    if (entry->key == NULL || entry->path == NULL) {
+        logError(ERR_FSTR, "file entry alloc failed", strerror(errno));
+        free(entry->key);
+        free(entry->path);
+        free(entry);
+        return NULL;
+    }
+
+    entry->hash = cacheHash(key);
+    entry->pathHash = cacheHash(path);
+    entry->fd = fd;
+    entry->size = st->st_size;
+    entry->ino = st->st_ino;
+    entry->mtime = st->st_mtim;
+    entry->mime = mime;
+    validatorInit(&entry->validator, st->st_ino, st->st_size, st->st_mtim);
+    atomic_init(&entry->refs, 1);
+    return entry;
+}
+
+// returns a referenced entry or NULL, every hit must be paired with fileEntryRelease
+fileEntryT *fileCacheGet(fileCacheT *cache, const char *key) {
+    uint32_t hash = cacheHash(key);
+
+    pthread_rwlock_rdlock(&cache->lock);
+    // ===== CRITICAL SECTION =====
+    fileEntryT *entry = find_file(cache, key, hash);
+    if (entry != NULL) {
+        atomic_fetch_add(&entry->refs, 1);
+    }
+    // ============================
+    pthread_rwlock_unlock(&cache->lock);
+
+    if (entry != NULL) {
+        atomic_fetch_add_explicit(&cache->hits, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&cache->misses, 1, memory_order_relaxed);
+    }
+    return entry;
+}
+
+unsigned fileCacheGeneration(fileCacheT *cache) {
+    return atomic_load(&cache->generation);
+}
+
+// inserts entry (the caller keeps its own reference) unless the tree changed since generation was read
+void fileCachePut(fileCacheT *cache, fileEntryT *entry, unsigned generation) {
+    pthread_rwlock_wrlock(&cache->lock);
+    // ===== CRITICAL SECTION =====
+    if (atomic_load(&cache->generation) != generation) {
+        atomic_store(&entry->removed, true);
+        pthread_rwlock_unlock(&cache->lock);
+        return;
+    }
+
+    fileEntryT *old = find_file(cache, entry->key, entry->hash);
+    if (old != NULL) {
+        unlink_file(cache, old);
+    }
+    if (cache->nEntries >= cache->maxEntries && cache->fifoHead != NULL) {
+        unlink_file(cache, cache->fifoHead);
+    }
+
+    atomic_fetch_add(&entry->refs, 1);
+    size_t bucket = entry->hash % cache->nBuckets;
+    entry->next = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+
+    bucket = entry->pathHash % cache->nBuckets;
+    entry->pathNext = cache->pathBuckets[bucket];
+    cache->pathBuckets[bucket] = entry;
+
+    entry->fifoPrev = cache->fifoTail;
+    if (cache->fifoTail != NULL) {
+        cache->fifoTail->fifoNext = entry;
+    } else {
+        cache->fifoHead = entry;
+    }
+    cache->fifoTail = entry;
+    cache->nEntries++;
+    // ============================
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+void fileEntryRetain(fileEntryT *entry) {
+    atomic_fetch_add(&entry->refs, 1);
+}
+
+void fileEntryRelease(fileEntryT *entry) {
+    if (atomic_fetch_sub(&entry->refs, 1) == 1) {
+        free_file(entry);
+    }
+}
+
+void fileCacheLogStats(fileCacheT *cache) {
+    logInfo("file cache: hits %llu, misses %llu, invalidations %llu, entries %zu",
+            atomic_load(&cache->hits), atomic_load(&cache->misses), atomic_load(&cache->invalidations),
+            cache->nEntries);
+}
+
+fileEntryT *find_file(fileCacheT *cache, const char *key, uint32_t hash) {
+    fileEntryT *entry = cache->buckets[hash % cache->nBuckets];
+    while (entry != NULL && (entry->hash != hash || strcmp(entry->key, key) != 0)) {
+        entry = entry->next;
+    }
+    return entry;
+}
+
+// must be called under the write lock, drops the reference held by the cache
+void unlink_file(fileCacheT *cache, fileEntryT *entry) {
+    fileEntryT **link = &cache->buckets[entry->hash % cache->nBuckets];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+
+    link = &cache->pathBuckets[entry->pathHash % cache->nBuckets];
+    while (*link != entry) {
+        link = &(*link)->pathNext;
+    }
+    *link = entry->pathNext;
+
+    if (entry->fifoPrev != NULL) {
+        entry->fifoPrev->fifoNext = entry->fifoNext;
+    } else {
+        cache->fifoHead = entry->fifoNext;
+    }
+    if (entry->fifoNext != NULL) {
+        entry->fifoNext->fifoPrev = entry->fifoPrev;
+    } else {
+        cache->fifoTail = entry->fifoPrev;
+    }
+
+    cache->nEntries--;
+    atomic_store(&entry->removed, true);
+    if (cache->listener != NULL) {
+        cache->listener(cache->listenerArg, entry->key);
+    }
+    fileEntryRelease(entry);
+}
+
+void free_file(fileEntryT *entry) {
+    if (entry->fd >= 0) {
+        close(entry->fd);
+    }
+    free(entry->key);
+    free(entry->path);
+    free(entry);
+}
+
+void invalidate_path(fileCacheT *cache, const char *path) {
+    uint32_t hash = cacheHash(path);
+
+    pthread_rwlock_wrlock(&cache->lock);
+    // ===== CRITICAL SECTION =====
+    atomic_fetch_add(&cache->generation, 1);
+    fileEntryT *entry = cache->pathBuckets[hash % cache->nBuckets];
+    while (entry != NULL) {
+        fileEntryT *next = entry->pathNext;
+        if (entry->pathHash == hash && strcmp(entry->path, path) == 0) {
+            logDebug("file cache: %s changed", entry->path);
+            unlink_file(cache, entry);
+            atomic_fetch_add_explicit(&cache->invalidations, 1, memory_order_relaxed);
+        }
+        entry = next;
+    }
+    // ============================
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+void invalidate_all(fileCacheT *cache) {
+    pthread_rwlock_wrlock(&cache->lock);
+    // ===== CRITICAL SECTION =====
+    atomic_fetch_add(&cache->generation, 1);
+    while (cache->fifoHead != NULL) {
+        unlink_file(cache, cache->fifoHead);
+        atomic_fetch_add_explicit(&cache->invalidations, 1, memory_order_relaxed);
+    }
+    if (cache->listener != NULL) {
+        cache->listener(cache->listenerArg, NULL);
+    }
+    // ============================
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+int watch_tree(fileCacheT *cache, const char *dir) {
+    int wd = inotify_add_watch(cache->inotifyFd, dir, WATCH_MASK | IN_ONLYDIR);
+    if (wd < 0) {
+        logError(ERR_FSTR, "inotify_add_watch failed", strerror(errno));
+        return -1;
+    }
+
+    if (wd >= cache->nWatchDirs) {
+        char **dirs = realloc(cache->watchDirs, (wd + 1) * sizeof(char *));
+        if (dirs == NULL) {
+            logError(ERR_FSTR, "watch dirs alloc failed", strerror(errno));
+            return -1;
+        }
+        memset(dirs + cache->nWatchDirs, 0, (wd + 1 - cache->nWatchDirs) * sizeof(char *));
+        cache->watchDirs = dirs;
+        cache->nWatchDirs = wd + 1;
+    }
+    free(cache->watchDirs[wd]);
+    cache->watchDirs[wd] = strdup(dir);
+
+    DIR *d = opendir(dir);
+    if (d == NULL) {
+        logError(ERR_FSTR, "opendir failed", strerror(errno));
+        return -1;
+    }
+
+    int rc = 0;
+    struct dirent *ent;
+    char sub[PATH_MAX];
+    while ((ent = readdir(d)) != NULL && rc == 0) {
+        if (ent->d_type != DT_DIR || strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+        if (snprintf(sub, sizeof(sub), "%s/%s", dir, ent->d_name) >= (int) sizeof(sub)) {
+            continue;
+        }
+        rc = watch_tree(cache, sub);
+    }
+    closedir(d);
+    return rc;
+}
+
+void *watch_routine(void *arg) {
+    fileCacheT *cache = (fileCacheT *) arg;
+    threadName = "inotify";
+
+    char buff[INOTIFY_BUF_SIZE] __attribute__((aligned(__alignof__(struct inotify_event))));
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+    while (true) {
+        // only cancellable while waiting, never with the cache lock held
+        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+        ssize_t len = read(cache->inotifyFd, buff, sizeof(buff));
+        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        if (len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logError(ERR_FSTR, "inotify read failed", strerror(errno));
+            break;
+        }
+
+        for (char *ptr = buff; ptr < buff + len;) {
+            struct inotify_event *event = (struct inotify_event *) ptr;
+            handle_event(cache, event);
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    // nothing guarantees freshness any more
+    invalidate_all(cache);
+    return NULL;
+}
+
+void handle_event(fileCacheT *cache, struct inotify_event *event) {
+    if (event->mask & IN_Q_OVERFLOW) {
+        logWarn("inotify queue overflow, dropping file cache");
+        invalidate_all(cache);
+        return;
+    }
+    if (event->wd < 0 || event->wd >= cache->nWatchDirs || cache->watchDirs[event->wd] == NULL) {
+        return;
+    }
+    const char *dir = cache->watchDirs[event->wd];
+
+    if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+        // a whole directory went away: resolved paths below it are meaningless now
+        free(cache->watchDirs[event->wd]);
+        cache->watchDirs[event->wd] = NULL;
+        invalidate_all(cache);
+        return;
+    }
+    if (event->len == 0) {
+        return;
+    }
+
+    char path[PATH_MAX];
+    if (snprintf(path, sizeof(path), "%s/%s", dir, event->name) >= (int) sizeof(path)) {
+        return;
+    }
+
+    if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            watch_tree(cache, path);
+        }
+        if (event->mask & (IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE)) {
+            invalidate_all(cache);
+        }
+        return;
+    }
+
+    invalidate_path(cache, path);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../log/log.h"
+#include "validator.h"
+
+typedef struct fileEntry fileEntryT;
+
+struct fileEntry {
+    char *key;
+    uint32_t hash;
+
+    // resolved path inside the root and a shared O_RDONLY fd,
+    // readers must use offset based I/O (pread, sendfile with offset)
+    char *path;
+    uint32_t pathHash;
+    int fd;
+
+    off_t size;
+    ino_t ino;
+    struct timespec mtime;
+    const char *mime;
+    validatorT validator;
+
+    atomic_int refs;
+    // set once the entry is no longer in the cache (or never made it there)
+    atomic_bool removed;
+
+    fileEntryT *next;
+    fileEntryT *pathNext;
+    fileEntryT *fifoPrev, *fifoNext;
+};
+
+// called with the key of every invalidated entry, NULL key means everything
+typedef void (*fileListenerT)(void *arg, const char *key);
+
+typedef struct fileCache {
+    pthread_rwlock_t lock;
+
+    fileEntryT **buckets;
+    fileEntryT **pathBuckets;
+    size_t nBuckets;
+    fileEntryT *fifoHead, *fifoTail;
+    size_t nEntries, maxEntries;
+
+    // inotify watcher of the root tree
+    char *root;
+    int inotifyFd;
+    char **watchDirs;
+    int nWatchDirs;
+    pthread_t watcher;
+    bool watching;
+
+    // bumped on every invalidation, lets fillers detect changes that raced with them
+    atomic_uint generation;
+
+    fileListenerT listener;
+    void *listenerArg;
+
+    atomic_ullong hits, misses, invalidations;
+} fileCacheT;
+
+fileCacheT *fileCacheNew(const char *root, size_t maxEntries);
+
+void fileCacheFree(fileCacheT *cache);
+
+int fileCacheStart(fileCacheT *cache);
+
+void fileCacheSetListener(fileCacheT *cache, fileListenerT listener, void *arg);
+
+fileEntryT *fileCacheGet(fileCacheT *cache, const char *key);
+
+unsigned fileCacheGeneration(fileCacheT *cache);
+
+void fileCachePut(fileCacheT *cache, fileEntryT *entry, unsigned generation);
+
+fileEntryT *fileEntryNew(const char *key, const char *path, int fd, struct stat *st, const char *mime);
+
+void fileEntryRetain(fileEntryT *entry);
+
+void fileEntryRelease(fileEntryT *entry);
+
+void fileCacheLogStats(fileCacheT *cache);
@@ -0,0 +1,11 @@
+#include "hash.h"
+
+// FNV-1a
+uint32_t cacheHash(const char *key) {
+    uint32_t hash = 2166136261u;
+    for (; *key; key++) {
+        hash ^= (unsigned char) *key;
+        hash *= 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,49 @@
+#define _GNU_SOURCE
+
+#include "validator.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void validatorInit(validatorT *validator, ino_t ino, off_t size, struct timespec mtime) {
+    // any change of the file replaces the inode or moves mtime, nanoseconds catch same-second rewrites
+    snprintf(validator->etag, sizeof(validator->etag), "\"%llx-%llx-%llx%09lx\"", (unsigned long long) ino,
+             (unsigned long long) size, (unsigned long long) mtime.tv_sec, (unsigned long) mtime.tv_nsec);
+    if (httpDateFormat(mtime.tv_sec, validator->lastModified, sizeof(validator->lastModified)) < 0) {
+        validator->lastModified[0] = '\0';
+    }
+    validator->mtime = mtime.tv_sec;
+}
+
+void validatorVariant(validatorT *variant, const validatorT *source, const char *coding) {
+    *variant = *source;
+    // "etag" -> "etag-coding"
+    size_t len = strlen(source->etag);
+    snprintf(variant->etag + len - 1, sizeof(variant->etag) - len + 1, "-%s\"", coding);
+}
+
+int httpDateFormat(time_t t, char *buff, size_t size) {
+    struct tm tm;
+    if (gmtime_r(&t, &tm) == NULL || strftime(buff, size, "%a, %d %b %Y %H:%M:%S GMT", &tm) == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int httpDateParse(const char *str, size_t len, time_t *t) {
+    char date[HTTP_DATE_LEN];
+    if (len >= sizeof(date)) {
+        return -1;
+    }
+    memcpy(date, str, len);
+    date[len] = '\0';
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char *end = strptime(date, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (end == NULL || *end != '\0') {
+        return -1;
+    }
+    *t = timegm(&tm);
+    return 0;
+}
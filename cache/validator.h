@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define ETAG_LEN 64
+#define HTTP_DATE_LEN 32
+
+// cache validators of one file version, rendered once and kept with the cached metadata
+typedef struct validator {
+    char etag[ETAG_LEN];
+    char lastModified[HTTP_DATE_LEN];
+    time_t mtime;
+} validatorT;
+
+void validatorInit(validatorT *validator, ino_t ino, off_t size, struct timespec mtime);
+
+// validators of an encoded representation of the same version, its entity tag has to differ
+void validatorVariant(validatorT *variant, const validatorT *source, const char *coding);
+
+// IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+int httpDateFormat(time_t t, char *buff, size_t size);
+
+int httpDateParse(const char *str, size_t len, time_t *t);
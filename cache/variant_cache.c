@@ -0,0 +1,510 @@
+#include "variant_cache.h"
+#include "hash.h"
+#include "../fs/root.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "../event/clock.h"
+
+// a missing or useless variant is looked for again after this long
+#define VARIANT_RECHECK_MS 10000
+// smaller bodies gain less than the headers cost
+#define COMPRESS_MIN_SIZE 256
+#define BROTLI_QUALITY 9
+#define GZIP_LEVEL 9
+
+variantT *find_variant(variantCacheT *cache, const char *key, uint32_t hash, encodingT enc);
+
+void schedule_variant(variantCacheT *cache, const char *key, uint32_t hash, encodingT enc, const char *mime,
+                      const validatorT *source);
+
+void unlink_variant(variantCacheT *cache, variantT *variant);
+
+void free_variant(variantT *variant);
+
+size_t variant_cost(variantT *variant);
+
+void *build_routine(void *arg);
+
+void build_variant(variantCacheT *cache, variantT *variant);
+
+int find_sidecar(variantCacheT *cache, variantT *variant, const struct stat *original);
+
+int compress_original(variantCacheT *cache, variantT *variant, const struct stat *original);
+
+char *compress_body(encodingT enc, const char *src, size_t len, size_t *out_len);
+
+int open_beneath(variantCacheT *cache, const char *path, struct stat *st);
+
+bool compressible(const char *mime);
+
+const char *encoding_suffix(encodingT enc);
+
+variantCacheT *variantCacheNew(int rootFd, size_t budget, size_t maxObject) {
+    variantCacheT *cache = calloc(1, sizeof(variantCacheT));
+    if (cache == NULL) {
+        logFatal(ERR_FSTR, "variant cache alloc failed", strerror(errno));
+        return NULL;
+    }
+
+    cache->nBuckets = VARIANT_BUCKETS_NUM;
+    cache->buckets = calloc(cache->nBuckets, sizeof(variantT *));
+    if (cache->buckets == NULL) {
+        logFatal(ERR_FSTR, "variant cache tables alloc failed", strerror(errno));
+        free(cache);
+        return NULL;
+    }
+
+    cache->rootFd = rootFd;
+    cache->budget = budget;
+    cache->maxObject = maxObject;
+    pthread_rwlock_init(&cache->lock, NULL);
+    pthread_mutex_init(&cache->jobLock, NULL);
+    pthread_cond_init(&cache->jobReady, NULL);
+
+    return cache;
+}
+
+void variantCacheFree(variantCacheT *cache) {
+    if (cache->building) {
+        pthread_mutex_lock(&cache->jobLock);
+        // ===== CRITICAL SECTION =====
+        cache->stopping = true;
+        pthread_cond_signal(&cache->jobReady);
+        // ============================
+        pthread_mutex_unlock(&cache->jobLock);
+        pthread_join(cache->builder, NULL);
+    }
+
+    // jobs never built hold a reference each
+    while (cache->jobHead != NULL) {
+        variantT *job = cache->jobHead;
+        cache->jobHead = job->jobNext;
+        variantRelease(job);
+    }
+    while (cache->fifoHead != NULL) {
+        unlink_variant(cache, cache->fifoHead);
+    }
+
+    pthread_cond_destroy(&cache->jobReady);
+    pthread_mutex_destroy(&cache->jobLock);
+    pthread_rwlock_destroy(&cache->lock);
+    free(cache->buckets);
+    free(cache);
+}
+
+int variantCacheStart(variantCacheT *cache) {
+    if (pthread_create(&cache->builder, NULL, build_routine, cache) != 0) {
+        logError(ERR_FSTR, "failed to create variant builder thread", strerror(errno));
+        return -1;
+    }
+    cache->building = true;
+    return 0;
+}
+
+variantT *variantCacheGet(variantCacheT *cache, const char *key, unsigned accepted, const char *mime,
+                          const validatorT *source) {
+    uint32_t hash = cacheHash(key);
+    long long now = clockNowMs();
+
+    for (encodingT enc = 0; enc < ENC_COUNT; ++enc) {
+        if (!(accepted & ENC_BIT(enc))) {
+            continue;
+        }
+
+        bool known = false;
+        pthread_rwlock_rdlock(&cache->lock);
+        // ===== CRITICAL SECTION =====
+        variantT *variant = find_variant(cache, key, hash, enc);
+        if (variant != NULL && strcmp(variant->source, source->etag) == 0) {
+            if (variant->state == VARIANT_SIDECAR || variant->state == VARIANT_MEMORY) {
+                atomic_fetch_add(&variant->refs, 1);
+                // ============================
+                pthread_rwlock_unlock(&cache->lock);
+                atomic_fetch_add_explicit(&cache->hits, 1, memory_order_relaxed);
+                return variant;
+            }
+            known = variant->state == VARIANT_PENDING || now - variant->checkedAt < VARIANT_RECHECK_MS;
+        }
+        // ============================
+        pthread_rwlock_unlock(&cache->lock);
+
+        // absent, built for another version or due for another probe
+        if (!known) {
+            schedule_variant(cache, key, hash, enc, mime, source);
+        }
+    }
+
+    atomic_fetch_add_explicit(&cache->misses, 1, memory_order_relaxed);
+    return NULL;
+}
+
+void variantRelease(variantT *variant) {
+    if (atomic_fetch_sub(&variant->refs, 1) == 1) {
+        free_variant(variant);
+    }
+}
+
+const char *encodingName(encodingT enc) {
+    return enc == ENC_BR ? "br" : "gzip";
+}
+
+void variantCacheLogStats(variantCacheT *cache) {
+    logInfo("variant cache: hits %llu, misses %llu, sidecars %llu, compressed %llu, skipped %llu, evicted %llu, "
+            "used %zu bytes", atomic_load(&cache->hits), atomic_load(&cache->misses), atomic_load(&cache->sidecars),
+            atomic_load(&cache->compressed), atomic_load(&cache->skipped), atomic_load(&cache->evictions),
+            cache->used);
+}
+
+variantT *find_variant(variantCacheT *cache, const char *key, uint32_t hash, encodingT enc) {
+    variantT *variant = cache->buckets[hash % cache->nBuckets];
+    while (variant != NULL && (variant->hash != hash || variant->enc != enc || strcmp(variant->key, key) != 0)) {
+        variant = variant->next;
+    }
+    return variant;
+}
+
+// inserts a pending variant and queues it for the builder unless another request already did
+void schedule_variant(variantCacheT *cache, const char *key, uint32_t hash, encodingT enc, const char *mime,
+                      const validatorT *source) {
+    variantT *variant = calloc(1, sizeof(variantT));
+    if (variant == NULL || (variant->key = strdup(key)) == NULL) {
+        logError(ERR_FSTR, "variant alloc failed", strerror(errno));
+        free(variant);
+        return;
+    }
+    variant->hash = hash;
+    variant->enc = enc;
+    strcpy(variant->source, source->etag);
+    variant->mime = mime;
+    variant->state = VARIANT_PENDING;
+    // the cache and the queued job hold a reference each
+    atomic_init(&variant->refs, 2);
+
+    validatorVariant(&variant->validator, source, encodingName(enc));
+
+    pthread_rwlock_wrlock(&cache->lock);
+    // ===== CRITICAL SECTION =====
+    variantT *old = find_variant(cache, key, hash, enc);
+    if (old != NULL && strcmp(old->source, source->etag) == 0 &&
+        (old->state != VARIANT_NONE || clockNowMs() - old->checkedAt < VARIANT_RECHECK_MS)) {
+        // ============================
+        pthread_rwlock_unlock(&cache->lock);
+        free_variant(variant);
+        return;
+    }
+    if (old != NULL) {
+        unlink_variant(cache, old);
+    }
+
+    variant->next = cache->buckets[hash % cache->nBuckets];
+    cache->buckets[hash % cache->nBuckets] = variant;
+    variant->fifoPrev = cache->fifoTail;
+    if (cache->fifoTail != NULL) {
+        cache->fifoTail->fifoNext = variant;
+    } else {
+        cache->fifoHead = variant;
+    }
+    cache->fifoTail = variant;
+    // ============================
+    pthread_rwlock_unlock(&cache->lock);
+
+    pthread_mutex_lock(&cache->jobLock);
+    // ===== CRITICAL SECTION =====
+    if (cache->jobTail != NULL) {
+        cache->jobTail->jobNext = variant;
+    } else {
+        cache->jobHead = variant;
+    }
+    cache->jobTail = variant;
+    pthread_cond_signal(&cache->jobReady);
+    // ============================
+    pthread_mutex_unlock(&cache->jobLock);
+}
+
+// must be called under the write lock, drops the reference held by the cache
+void unlink_variant(variantCacheT *cache, variantT *variant) {
+    variantT **link = &cache->buckets[variant->hash % cache->nBuckets];
+    while (*link != variant) {
+        link = &(*link)->next;
+    }
+    *link = variant->next;
+
+    if (variant->fifoPrev != NULL) {
+        variant->fifoPrev->fifoNext = variant->fifoNext;
+    } else {
+        cache->fifoHead = variant->fifoNext;
+    }
+    if (variant->fifoNext != NULL) {
+        variant->fifoNext->fifoPrev = variant->fifoPrev;
+    } else {
+        cache->fifoTail = variant->fifoPrev;
+    }
+
+    cache->used -= variant_cost(variant);
+    variant->removed = true;
+    variantRelease(variant);
+}
+
+void free_variant(variantT *variant) {
+    if (variant->file != NULL) {
+        fileEntryRelease(variant->file);
+    }
+    free(variant->body);
+    free(variant->key);
+    free(variant);
+}
+
+// only compressed bodies count, sidecars and probe results are bounded by the number of files
+size_t variant_cost(variantT *variant) {
+    return variant->state == VARIANT_MEMORY ? variant->bodyLen : 0;
+}
+
+void *build_routine(void *arg) {
+    variantCacheT *cache = (variantCacheT *) arg;
+    threadName = "variants";
+
+    while (true) {
+        pthread_mutex_lock(&cache->jobLock);
+        // ===== CRITICAL SECTION =====
+        while (cache->jobHead == NULL && !cache->stopping) {
+            pthread_cond_wait(&cache->jobReady, &cache->jobLock);
+        }
+        variantT *job = cache->jobHead;
+        if (job != NULL && !cache->stopping) {
+            cache->jobHead = job->jobNext;
+            if (cache->jobHead == NULL) {
+                cache->jobTail = NULL;
+            }
+        }
+        bool stopping = cache->stopping;
+        // ============================
+        pthread_mutex_unlock(&cache->jobLock);
+
+        if (stopping) {
+            return NULL;
+        }
+        build_variant(cache, job);
+        variantRelease(job);
+    }
+}
+
+// finds a sidecar or compresses the original, the result is published under the write lock
+void build_variant(variantCacheT *cache, variantT *variant) {
+    struct stat st;
+    validatorT current;
+    int fd = open_beneath(cache, variant->key, &st);
+    if (fd >= 0) {
+        validatorInit(&current, st.st_ino, st.st_size, st.st_mtim);
+        close(fd);
+    }
+
+    // a changed original is left to the next request, it asks for the new version
+    int rc = -1;
+    if (fd >= 0 && strcmp(current.etag, variant->source) == 0) {
+        rc = find_sidecar(cache, variant, &st);
+        if (rc < 0) {
+            rc = compress_original(cache, variant, &st);
+        }
+    }
+
+    pthread_rwlock_wrlock(&cache->lock);
+    // ===== CRITICAL SECTION =====
+    variant->checkedAt = clockNowMs();
+    if (variant->removed) {
+        // ============================
+        pthread_rwlock_unlock(&cache->lock);
+        return;
+    }
+
+    if (rc < 0) {
+        variant->state = VARIANT_NONE;
+        atomic_fetch_add_explicit(&cache->skipped, 1, memory_order_relaxed);
+    } else if (variant->file != NULL) {
+        variant->state = VARIANT_SIDECAR;
+        atomic_fetch_add_explicit(&cache->sidecars, 1, memory_order_relaxed);
+    } else {
+        variant->state = VARIANT_MEMORY;
+        cache->used += variant_cost(variant);
+        atomic_fetch_add_explicit(&cache->compressed, 1, memory_order_relaxed);
+    }
+
+    // the oldest compressed bodies make room, the one just built stays
+    variantT *victim = cache->fifoHead;
+    while (cache->used > cache->budget && victim != NULL) {
+        variantT *next = victim->fifoNext;
+        if (victim != variant && victim->state == VARIANT_MEMORY) {
+            unlink_variant(cache, victim);
+            atomic_fetch_add_explicit(&cache->evictions, 1, memory_order_relaxed);
+        }
+        victim = next;
+    }
+    // ============================
+    pthread_rwlock_unlock(&cache->lock);
+}
+
+// a sibling file with the coding's suffix, at least as new as the original
+int find_sidecar(variantCacheT *cache, variantT *variant, const struct stat *original) {
+    char name[PATH_MAX];
+    int rc = snprintf(name, sizeof(name), "%s%s", variant->key, encoding_suffix(variant->enc));
+    if (rc < 0 || (size_t) rc >= sizeof(name)) {
+        return -1;
+    }
+
+    struct stat st;
+    int fd = open_beneath(cache, name, &st);
+    if (fd < 0) {
+        return -1;
+    }
+    if (st.st_mtim.tv_sec < original->st_mtim.tv_sec ||
+        (st.st_mtim.tv_sec == original->st_mtim.tv_sec && st.st_mtim.tv_nsec < original->st_mtim.tv_nsec)) {
+        logWarn("%s is older than %s, ignored", name, variant->key);
+        close(fd);
+        return -1;
+    }
+
+    variant->file = fileEntryNew(name, name, fd, &st, variant->mime);
+    if (variant->file == NULL) {
+        close(fd);
+        return -1;
+    }
+    variant->bodyLen = st.st_size;
+    return 0;
+}
+
+int compress_original(variantCacheT *cache, variantT *variant, const struct stat *original) {
+    size_t size = original->st_size;
+    if (!compressible(variant->mime) || size < COMPRESS_MIN_SIZE || size > cache->maxObject ||
+        size > cache->budget) {
+        return -1;
+    }
+
+    struct stat st;
+    int fd = open_beneath(cache, variant->key, &st);
+    if (fd < 0) {
+        return -1;
+    }
+    char *src = malloc(size);
+    if (src == NULL) {
+        logError(ERR_FSTR, "failed alloc compression input", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    size_t total_read = 0;
+    while (total_read < size) {
+        ssize_t byte_read = pread(fd, src + total_read, size - total_read, total_read);
+        if (byte_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (byte_read <= 0) {
+            break;
+        }
+        total_read += byte_read;
+    }
+    close(fd);
+    if (total_read < size) {
+        free(src);
+        return -1;
+    }
+
+    size_t out_len;
+    char *out = compress_body(variant->enc, src, size, &out_len);
+    free(src);
+    // less than a tenth saved is not worth a second representation
+    if (out == NULL || out_len > size - size / 10) {
+        free(out);
+        return -1;
+    }
+
+    variant->body = out;
+    variant->bodyLen = out_len;
+    logDebug("%s: %zu -> %zu bytes (%s)", variant->key, size, out_len, encodingName(variant->enc));
+    return 0;
+}
+
+char *compress_body(encodingT enc, const char *src, size_t len, size_t *out_len) {
+#ifdef HAVE_BROTLI
+    if (enc == ENC_BR) {
+        size_t cap = BrotliEncoderMaxCompressedSize(len);
+        uint8_t *out = malloc(cap > 0 ? cap : len + 1024);
+        *out_len = cap > 0 ? cap : len + 1024;
+        if (out == NULL || !BrotliEncoderCompress(BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, len,
+                                                  (const uint8_t *) src, out_len, out)) {
+            free(out);
+            return NULL;
+        }
+        return (char *) out;
+    }
+#endif
+#ifdef HAVE_ZLIB
+    if (enc == ENC_GZIP) {
+        z_stream zs;
+        memset(&zs, 0, sizeof(zs));
+        // 16 + window bits selects the gzip wrapper
+        if (deflateInit2(&zs, GZIP_LEVEL, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return NULL;
+        }
+        size_t cap = deflateBound(&zs, len);
+        char *out = malloc(cap);
+        if (out == NULL) {
+            deflateEnd(&zs);
+            return NULL;
+        }
+        zs.next_in = (Bytef *) src;
+        zs.avail_in = len;
+        zs.next_out = (Bytef *) out;
+        zs.avail_out = cap;
+        int rc = deflate(&zs, Z_FINISH);
+        *out_len = zs.total_out;
+        deflateEnd(&zs);
+        if (rc != Z_STREAM_END) {
+            free(out);
+            return NULL;
+        }
+        return out;
+    }
+#endif
+    (void) enc;
+    (void) src;
+    (void) len;
+    (void) out_len;
+    return NULL;
+}
+
+// opens a regular file beneath the root
+int open_beneath(variantCacheT *cache, const char *path, struct stat *st) {
+    int fd = rootOpen(cache->rootFd, path, O_RDONLY);
+    if (fd < 0) {
+        if (errno == EXDEV || errno == ELOOP) {
+            logError("variant outside the root: %s", path);
+        }
+        return -1;
+    }
+    if (fstat(fd, st) < 0 || !S_ISREG(st->st_mode)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool compressible(const char *mime) {
+    if (mime == NULL) {
+        return false;
+    }
+    return strncmp(mime, "text/", sizeof("text/") - 1) == 0 || strstr(mime, "javascript") != NULL ||
+           strstr(mime, "json") != NULL || strstr(mime, "xml") != NULL;
+}
+
+const char *encoding_suffix(encodingT enc) {
+    return enc == ENC_BR ? ".br" : ".gz";
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include "../log/log.h"
+#include "file_cache.h"
+#include "validator.h"
+
+#define VARIANT_BUCKETS_NUM 1024
+
+// content codings in order of preference
+typedef enum contentEncoding {
+    ENC_BR, ENC_GZIP, ENC_COUNT
+} encodingT;
+
+#define ENC_BIT(enc) (1u << (enc))
+
+typedef enum variantState {
+    VARIANT_PENDING,    // queued for the background builder
+    VARIANT_NONE,       // no usable sidecar and not worth compressing, probed again later
+    VARIANT_SIDECAR,    // precompressed sibling file, sent with sendfile
+    VARIANT_MEMORY      // compressed once in the background, sent from memory
+} variantStateT;
+
+typedef struct variant variantT;
+
+struct variant {
+    char *key;
+    uint32_t hash;
+    encodingT enc;
+
+    // etag of the original version the variant stands for
+    char source[ETAG_LEN];
+    const char *mime;
+    variantStateT state;
+    long long checkedAt;
+
+    // validators of the encoded representation and its body, a sidecar or memory
+    validatorT validator;
+    fileEntryT *file;
+    char *body;
+    size_t bodyLen;
+
+    atomic_int refs;
+    bool removed;
+
+    variantT *next;
+    variantT *fifoPrev, *fifoNext;
+    variantT *jobNext;
+};
+
+typedef struct variantCache {
+    pthread_rwlock_t lock;
+
+    variantT **buckets;
+    size_t nBuckets;
+    variantT *fifoHead, *fifoTail;
+
+    // O_PATH root the originals and sidecars are opened beneath
+    int rootFd;
+
+    // memory taken by compressed bodies, 0 budget leaves only sidecars
+    size_t budget;
+    size_t used;
+    size_t maxObject;
+
+    // background builder
+    pthread_mutex_t jobLock;
+    pthread_cond_t jobReady;
+    variantT *jobHead, *jobTail;
+    bool stopping;
+    pthread_t builder;
+    bool building;
+
+    atomic_ullong hits, misses, sidecars, compressed, skipped, evictions;
+} variantCacheT;
+
+variantCacheT *variantCacheNew(int rootFd, size_t budget, size_t maxObject);
+
+void variantCacheFree(variantCacheT *cache);
+
+int variantCacheStart(variantCacheT *cache);
+
+// best ready variant among the accepted codings for the given version of key, unknown ones are built
+// in the background; every hit must be paired with variantRelease
+variantT *variantCacheGet(variantCacheT *cache, const char *key, unsigned accepted, const char *mime,
+                          const validatorT *source);
+
+void variantRelease(variantT *variant);
+
+const char *encodingName(encodingT enc);
+
+void variantCacheLogStats(variantCacheT *cache);
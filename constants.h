@@ -1,8 +1,58 @@
 #pragma once
 
+#include <stdbool.h>
+
 const int port = 8100;
 const char ipAddress[] = "0.0.0.0";
 
 const int nThreads = 8;
 
+// "pool": one event loop feeding the thread pool, "reuseport": an SO_REUSEPORT event loop per thread,
+// "uring": an SO_REUSEPORT io_uring loop per thread
+const char serverMode[] = "pool";
+
+// pool mode scheduler: "shared" queue, or per-worker queues with stealing filled "roundrobin" or "leastloaded"
+const char poolScheduler[] = "shared";
+
 const char wd[] = "./static";
+
+// event loop: "epoll" or "poll"
+const char eventEngine[] = "epoll";
+const bool edgeTriggered = false;
+
+// keep-alive idle timeout in seconds (0 disables keep-alive), requests per connection (0 is unlimited)
+const int keepAliveTimeout = 5;
+const int keepAliveMax = 100;
+
+// seconds a client has to send a complete request header block and to take more of a response (0 disables)
+const int headerTimeout = 10;
+const int sendTimeout = 30;
+
+// listener: seconds TCP_DEFER_ACCEPT holds a connection back until its request arrives, and the TCP_FASTOPEN
+// queue length (0 disables either)
+const int deferAccept = 0;
+const int fastOpenQueue = 0;
+// kilobytes of socket send buffer per client connection, set on the listener (0 leaves it to autotuning)
+const int sendBufferKb = 0;
+
+// open connections before new ones are answered with a 503 (0 leaves only the fd limit), and the pool queue wait
+// in milliseconds requests are answered with a 503 above, judged like CoDel over 100 ms intervals (0 disables)
+const int maxConnections = 10000;
+const int queueTargetMs = 50;
+
+// file transmission: "sendfile", "splice" or "copy"
+const char sendMode[] = "sendfile";
+
+// hot-file cache: budget in megabytes (0 disables), largest cached file, misses before a file is admitted
+const int cacheBudgetMb = 64;
+const int cacheMaxFileKb = 1024;
+const int cacheAdmitHits = 2;
+
+// open file descriptors and metadata kept by the inotify-backed file cache (0 disables)
+const int fileCacheEntries = 1024;
+
+// memory in megabytes for compressible files compressed once in the background (0 leaves only .br/.gz sidecars)
+const int compressBudgetMb = 16;
+
+// url serving request counters and latency histograms in the Prometheus text format (empty disables it)
+const char metricsPath[] = "/__metrics";
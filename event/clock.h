@@ -0,0 +1,7 @@
+#pragma once
+
+#include <time.h>
+
+long long clockNowMs();
+
+long long clockNowNs();
@@ -0,0 +1,271 @@
+#include "poller.h"
+
+#define EP_EVENTS_NUM 1024
+
+uint32_t to_epoll_events(pollerT *poller, uint32_t events);
+
+short to_poll_events(uint32_t events);
+
+int epoll_wait_events(pollerT *poller, pollerEventT *events, int maxEvents, int timeoutMs);
+
+int poll_wait_events(pollerT *poller, pollerEventT *events, int maxEvents, int timeoutMs);
+
+pollerT *pollerNew(pollerTypeT type, bool edgeTriggered, long maxFds) {
+    pollerT *poller = calloc(1, sizeof(pollerT));
+    if (poller == NULL) {
+        logFatal(ERR_FSTR, "poller alloc failed", strerror(errno));
+        return NULL;
+    }
+    poller->type = type;
+    poller->maxFds = maxFds;
+    poller->epfd = -1;
+
+    if (type == POLLER_EPOLL) {
+        poller->edgeTriggered = edgeTriggered;
+        poller->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (poller->epfd < 0) {
+            logFatal(ERR_FSTR, "epoll_create1 failed", strerror(errno));
+            free(poller);
+            return NULL;
+        }
+
+        poller->nEpEvents = EP_EVENTS_NUM;
+        poller->epEvents = calloc(poller->nEpEvents, sizeof(struct epoll_event));
+        if (poller->epEvents == NULL) {
+            logFatal(ERR_FSTR, "epoll events alloc failed", strerror(errno));
+            close(poller->epfd);
+            free(poller);
+            return NULL;
+        }
+        return poller;
+    }
+
+    if (edgeTriggered) {
+        logWarn("poll backend is level-triggered only, edge-triggered mode ignored");
+    }
+
+    poller->pfds = calloc(maxFds, sizeof(struct pollfd));
+    poller->flags = calloc(maxFds, sizeof(uint32_t));
+    poller->slots = malloc(maxFds * sizeof(long));
+    if (poller->pfds == NULL || poller->flags == NULL || poller->slots == NULL) {
+        logFatal(ERR_FSTR, "poll fds alloc failed", strerror(errno));
+        pollerFree(poller);
+        return NULL;
+    }
+    for (long i = 0; i < maxFds; ++i) {
+        poller->slots[i] = -1;
+    }
+
+    return poller;
+}
+
+void pollerFree(pollerT *poller) {
+    if (poller->epfd >= 0) {
+        close(poller->epfd);
+    }
+    free(poller->epEvents);
+    free(poller->pfds);
+    free(poller->flags);
+    free(poller->slots);
+    free(poller);
+}
+
+const char *pollerName(pollerT *poller) {
+    if (poller->type == POLLER_POLL) {
+        return "poll";
+    }
+    return poller->edgeTriggered ? "epoll (edge-triggered)" : "epoll (level-triggered)";
+}
+
+int pollerAdd(pollerT *poller, int fd, uint32_t events) {
+    if (fd < 0 || fd >= poller->maxFds) {
+        logError("poller: fd %d out of range", fd);
+        return -1;
+    }
+
+    if (poller->type == POLLER_EPOLL) {
+        struct epoll_event ev = {.events = to_epoll_events(poller, events), .data.fd = fd};
+        if (epoll_ctl(poller->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            logError(ERR_FSTR, "epoll_ctl add failed", strerror(errno));
+            return -1;
+        }
+        poller->nFds++;
+        return 0;
+    }
+
+    if (poller->slots[fd] >= 0) {
+        return pollerMod(poller, fd, events);
+    }
+
+    long slot = poller->nFds++;
+    poller->slots[fd] = slot;
+    poller->flags[slot] = events;
+    poller->pfds[slot].fd = fd;
+    poller->pfds[slot].events = to_poll_events(events);
+    poller->pfds[slot].revents = 0;
+    return 0;
+}
+
+int pollerMod(pollerT *poller, int fd, uint32_t events) {
+    if (fd < 0 || fd >= poller->maxFds) {
+        logError("poller: fd %d out of range", fd);
+        return -1;
+    }
+
+    if (poller->type == POLLER_EPOLL) {
+        struct epoll_event ev = {.events = to_epoll_events(poller, events), .data.fd = fd};
+        if (epoll_ctl(poller->epfd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+            if (errno == ENOENT) {
+                return pollerAdd(poller, fd, events);
+            }
+            logError(ERR_FSTR, "epoll_ctl mod failed", strerror(errno));
+            return -1;
+        }
+        return 0;
+    }
+
+    long slot = poller->slots[fd];
+    if (slot < 0) {
+        return pollerAdd(poller, fd, events);
+    }
+    poller->flags[slot] = events;
+    poller->pfds[slot].fd = fd;
+    poller->pfds[slot].events = to_poll_events(events);
+    return 0;
+}
+
+int pollerDel(pollerT *poller, int fd) {
+    if (fd < 0 || fd >= poller->maxFds) {
+        return -1;
+    }
+
+    if (poller->type == POLLER_EPOLL) {
+        if (epoll_ctl(poller->epfd, EPOLL_CTL_DEL, fd, NULL) < 0) {
+            if (errno != ENOENT) {
+                logError(ERR_FSTR, "epoll_ctl del failed", strerror(errno));
+            }
+            return -1;
+        }
+        poller->nFds--;
+        return 0;
+    }
+
+    long slot = poller->slots[fd];
+    if (slot < 0) {
+        return -1;
+    }
+
+    // keep pfds dense: move the last entry into the freed slot
+    long last = --poller->nFds;
+    if (slot != last) {
+        poller->pfds[slot] = poller->pfds[last];
+        poller->flags[slot] = poller->flags[last];
+        int moved = poller->pfds[slot].fd < 0 ? ~poller->pfds[slot].fd : poller->pfds[slot].fd;
+        poller->slots[moved] = slot;
+    }
+    poller->slots[fd] = -1;
+    return 0;
+}
+
+int pollerWait(pollerT *poller, pollerEventT *events, int maxEvents, int timeoutMs) {
+    if (poller->type == POLLER_EPOLL) {
+        return epoll_wait_events(poller, events, maxEvents, timeoutMs);
+    }
+    return poll_wait_events(poller, events, maxEvents, timeoutMs);
+}
+
+int epoll_wait_events(pollerT *poller, pollerEventT *events, int maxEvents, int timeoutMs) {
+    if (maxEvents > poller->nEpEvents) {
+        maxEvents = poller->nEpEvents;
+    }
+
+    int n_ready = epoll_wait(poller->epfd, poller->epEvents, maxEvents, timeoutMs);
+    if (n_ready < 0) {
+        if (errno != EINTR) {
+            logError(ERR_FSTR, "epoll_wait error", strerror(errno));
+        }
+        return -1;
+    }
+
+    for (int i = 0; i < n_ready; ++i) {
+        uint32_t ev = poller->epEvents[i].events;
+        events[i].fd = poller->epEvents[i].data.fd;
+        events[i].events = 0;
+        if (ev & (EPOLLIN | EPOLLRDHUP)) {
+            events[i].events |= POLLER_IN;
+        }
+        if (ev & EPOLLOUT) {
+            events[i].events |= POLLER_OUT;
+        }
+        if (ev & (EPOLLERR | EPOLLHUP)) {
+            events[i].events |= POLLER_ERR;
+        }
+    }
+    return n_ready;
+}
+
+int poll_wait_events(pollerT *poller, pollerEventT *events, int maxEvents, int timeoutMs) {
+    int n_ready = poll(poller->pfds, poller->nFds, timeoutMs);
+    if (n_ready < 0) {
+        if (errno != EINTR) {
+            logError(ERR_FSTR, "poll error", strerror(errno));
+        }
+        return -1;
+    }
+
+    int n = 0;
+    for (long i = 0; i < poller->nFds && n < n_ready && n < maxEvents; ++i) {
+        struct pollfd *pfd = &poller->pfds[i];
+        if (pfd->fd < 0 || pfd->revents == 0) {
+            continue;
+        }
+
+        events[n].fd = pfd->fd;
+        events[n].events = 0;
+        if (pfd->revents & POLLIN) {
+            events[n].events |= POLLER_IN;
+        }
+        if (pfd->revents & POLLOUT) {
+            events[n].events |= POLLER_OUT;
+        }
+        if (pfd->revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            events[n].events |= POLLER_ERR;
+        }
+        n++;
+
+        pfd->revents = 0;
+        if (poller->flags[i] & POLLER_ONESHOT) {
+            // negative fds are ignored by poll() until re-armed with pollerMod
+            pfd->fd = ~pfd->fd;
+        }
+    }
+    return n;
+}
+
+uint32_t to_epoll_events(pollerT *poller, uint32_t events) {
+    uint32_t ev = 0;
+    if (events & POLLER_IN) {
+        ev |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (events & POLLER_OUT) {
+        ev |= EPOLLOUT;
+    }
+    if (events & POLLER_ONESHOT) {
+        ev |= EPOLLONESHOT;
+    }
+    if (poller->edgeTriggered) {
+        ev |= EPOLLET;
+    }
+    return ev;
+}
+
+short to_poll_events(uint32_t events) {
+    short ev = 0;
+    if (events & POLLER_IN) {
+        ev |= POLLIN;
+    }
+    if (events & POLLER_OUT) {
+        ev |= POLLOUT;
+    }
+    return ev;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+
+#include "../log/log.h"
+
+// interest / readiness flags
+#define POLLER_IN 0x1u
+#define POLLER_OUT 0x2u
+#define POLLER_ERR 0x4u
+// interest only: disarm fd after its first event
+#define POLLER_ONESHOT 0x8u
+
+typedef enum pollerType {
+    POLLER_POLL, POLLER_EPOLL
+} pollerTypeT;
+
+typedef struct pollerEvent {
+    int fd;
+    uint32_t events;
+} pollerEventT;
+
+typedef struct poller {
+    pollerTypeT type;
+    bool edgeTriggered;
+    long maxFds;
+    long nFds;
+
+    // epoll backend
+    int epfd;
+    struct epoll_event *epEvents;
+    int nEpEvents;
+
+    // poll backend: dense pollfd array + fd -> slot index
+    struct pollfd *pfds;
+    uint32_t *flags;
+    long *slots;
+} pollerT;
+
+pollerT *pollerNew(pollerTypeT type, bool edgeTriggered, long maxFds);
+
+void pollerFree(pollerT *poller);
+
+int pollerAdd(pollerT *poller, int fd, uint32_t events);
+
+// registers fd if it is not polled yet
+int pollerMod(pollerT *poller, int fd, uint32_t events);
+
+// an fd that was never registered is not an error worth logging
+int pollerDel(pollerT *poller, int fd);
+
+int pollerWait(pollerT *poller, pollerEventT *events, int maxEvents, int timeoutMs);
+
+const char *pollerName(pollerT *poller);
@@ -0,0 +1,257 @@
+#include "uring.h"
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+int uring_setup(unsigned entries, struct io_uring_params *params);
+
+int uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize);
+
+int uring_register(int fd, unsigned opcode, void *arg, unsigned nrArgs);
+
+// multishot accept/recv and provided buffer rings need 5.19+/6.0+ kernels,
+// zero-copy send came with 6.0 as well and serves as the version probe
+bool uringSupported() {
+    uringT *ring = uringNew(4);
+    if (ring == NULL) {
+        return false;
+    }
+
+    size_t probe_size = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe *probe = calloc(1, probe_size);
+    bool supported = probe != NULL && uring_register(ring->fd, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0;
+    const int ops[] = {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SENDMSG, IORING_OP_SPLICE,
+                       IORING_OP_ASYNC_CANCEL, IORING_OP_READ, IORING_OP_SEND_ZC};
+    for (size_t i = 0; supported && i < sizeof(ops) / sizeof(ops[0]); ++i) {
+        supported = ops[i] <= probe->last_op && (probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+
+    if (supported) {
+        uringBufRingT *buf_ring = uringBufRingNew(ring, 0, 1, 64);
+        supported = buf_ring != NULL;
+        if (buf_ring != NULL) {
+            uringBufRingFree(ring, buf_ring);
+        }
+    }
+
+    uringFree(ring);
+    return supported;
+}
+
+uringT *uringNew(unsigned entries) {
+    uringT *ring = calloc(1, sizeof(uringT));
+    if (ring == NULL) {
+        logError(ERR_FSTR, "uring alloc failed", strerror(errno));
+        return NULL;
+    }
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+
+    ring->fd = uring_setup(entries, &params);
+    if (ring->fd < 0) {
+        logWarn(ERR_FSTR, "io_uring_setup failed", strerror(errno));
+        free(ring);
+        return NULL;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        logWarn("io_uring: kernel lacks single mmap or extended enter arguments");
+        close(ring->fd);
+        free(ring);
+        return NULL;
+    }
+
+    ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (ring->cqRingSize > ring->sqRingSize) {
+        ring->sqRingSize = ring->cqRingSize;
+    }
+    ring->cqRingSize = ring->sqRingSize;
+
+    ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                        IORING_OFF_SQ_RING);
+    if (ring->sqRing == MAP_FAILED) {
+        logError(ERR_FSTR, "io_uring ring mmap failed", strerror(errno));
+        close(ring->fd);
+        free(ring);
+        return NULL;
+    }
+    ring->cqRing = ring->sqRing;
+
+    ring->sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        logError(ERR_FSTR, "io_uring sqes mmap failed", strerror(errno));
+        munmap(ring->sqRing, ring->sqRingSize);
+        close(ring->fd);
+        free(ring);
+        return NULL;
+    }
+
+    char *sq = (char *) ring->sqRing;
+    ring->sqHead = (atomic_uint *) (sq + params.sq_off.head);
+    ring->sqTail = (atomic_uint *) (sq + params.sq_off.tail);
+    ring->sqMask = *(unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sqArray = (unsigned *) (sq + params.sq_off.array);
+    ring->sqTailLocal = atomic_load(ring->sqTail);
+
+    char *cq = (char *) ring->cqRing;
+    ring->cqHead = (atomic_uint *) (cq + params.cq_off.head);
+    ring->cqTail = (atomic_uint *) (cq + params.cq_off.tail);
+    ring->cqMask = *(unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+
+    return ring;
+}
+
+void uringFree(uringT *ring) {
+    munmap(ring->sqes, ring->sqesSize);
+    munmap(ring->sqRing, ring->sqRingSize);
+    close(ring->fd);
+    free(ring);
+}
+
+// NULL when the submission queue is full, submit and retry then
+struct io_uring_sqe *uringGetSqe(uringT *ring) {
+    unsigned head = atomic_load_explicit(ring->sqHead, memory_order_acquire);
+    if (ring->sqTailLocal - head > ring->sqMask) {
+        return NULL;
+    }
+
+    unsigned idx = ring->sqTailLocal & ring->sqMask;
+    struct io_uring_sqe *sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sqArray[idx] = idx;
+    ring->sqTailLocal++;
+    ring->toSubmit++;
+    return sqe;
+}
+
+// submits everything queued and waits for waitNr completions or the timeout (-1 waits forever)
+int uringSubmitAndWait(uringT *ring, unsigned waitNr, int timeoutMs) {
+    atomic_store_explicit(ring->sqTail, ring->sqTailLocal, memory_order_release);
+    unsigned to_submit = ring->toSubmit;
+    ring->toSubmit = 0;
+
+    unsigned flags = waitNr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    if (waitNr > 0 && timeoutMs >= 0) {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (long long) (timeoutMs % 1000) * 1000000;
+        arg.ts = (uint64_t) (uintptr_t) &ts;
+    }
+    flags |= IORING_ENTER_EXT_ARG;
+
+    int rc = uring_enter(ring->fd, to_submit, waitNr, flags, &arg, sizeof(arg));
+    if (rc < 0 && (errno == ETIME || errno == EINTR)) {
+        return 0;
+    }
+    return rc;
+}
+
+struct io_uring_cqe *uringPeekCqe(uringT *ring) {
+    unsigned head = atomic_load_explicit(ring->cqHead, memory_order_relaxed);
+    if (head == atomic_load_explicit(ring->cqTail, memory_order_acquire)) {
+        return NULL;
+    }
+    return &ring->cqes[head & ring->cqMask];
+}
+
+void uringCqeSeen(uringT *ring) {
+    atomic_fetch_add_explicit(ring->cqHead, 1, memory_order_release);
+}
+
+uringBufRingT *uringBufRingNew(uringT *ring, unsigned short groupId, unsigned nBufs, unsigned bufSize) {
+    // the kernel wants a power of two number of entries
+    unsigned entries = 1;
+    while (entries < nBufs) {
+        entries <<= 1;
+    }
+
+    uringBufRingT *buf_ring = calloc(1, sizeof(uringBufRingT));
+    if (buf_ring == NULL) {
+        logError(ERR_FSTR, "buffer ring alloc failed", strerror(errno));
+        return NULL;
+    }
+    buf_ring->nBufs = entries;
+    buf_ring->bufSize = bufSize;
+    buf_ring->groupId = groupId;
+
+    buf_ring->ringSize = entries * sizeof(struct io_uring_buf);
+    buf_ring->ring = mmap(NULL, buf_ring->ringSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf_ring->ring == MAP_FAILED) {
+        logError(ERR_FSTR, "buffer ring mmap failed", strerror(errno));
+        free(buf_ring);
+        return NULL;
+    }
+
+    buf_ring->bufs = malloc((size_t) entries * bufSize);
+    if (buf_ring->bufs == NULL) {
+        logError(ERR_FSTR, "buffers alloc failed", strerror(errno));
+        munmap(buf_ring->ring, buf_ring->ringSize);
+        free(buf_ring);
+        return NULL;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t) (uintptr_t) buf_ring->ring;
+    reg.ring_entries = entries;
+    reg.bgid = groupId;
+    if (uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        logWarn(ERR_FSTR, "io_uring buffer ring registration failed", strerror(errno));
+        free(buf_ring->bufs);
+        munmap(buf_ring->ring, buf_ring->ringSize);
+        free(buf_ring);
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < entries; ++i) {
+        uringBufRecycle(buf_ring, (unsigned short) i);
+    }
+    return buf_ring;
+}
+
+void uringBufRingFree(uringT *ring, uringBufRingT *bufRing) {
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = bufRing->groupId;
+    uring_register(ring->fd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+
+    free(bufRing->bufs);
+    munmap(bufRing->ring, bufRing->ringSize);
+    free(bufRing);
+}
+
+char *uringBuf(uringBufRingT *bufRing, unsigned short bid) {
+    return bufRing->bufs + (size_t) bid * bufRing->bufSize;
+}
+
+// hands a buffer back to the kernel
+void uringBufRecycle(uringBufRingT *bufRing, unsigned short bid) {
+    struct io_uring_buf *buf = &bufRing->ring->bufs[bufRing->tail & (bufRing->nBufs - 1)];
+    buf->addr = (uint64_t) (uintptr_t) uringBuf(bufRing, bid);
+    buf->len = bufRing->bufSize;
+    buf->bid = bid;
+    bufRing->tail++;
+    atomic_store_explicit((_Atomic unsigned short *) &bufRing->ring->tail, bufRing->tail, memory_order_release);
+}
+
+int uring_setup(unsigned entries, struct io_uring_params *params) {
+    return (int) syscall(__NR_io_uring_setup, entries, params);
+}
+
+int uring_enter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void *arg, size_t argSize) {
+    return (int) syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize);
+}
+
+int uring_register(int fd, unsigned opcode, void *arg, unsigned nrArgs) {
+    return (int) syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
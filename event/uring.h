@@ -0,0 +1,66 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "../log/log.h"
+
+// minimal io_uring binding over the raw syscalls (no liburing)
+typedef struct uring {
+    int fd;
+
+    // submission queue
+    atomic_uint *sqHead, *sqTail;
+    unsigned sqMask;
+    unsigned *sqArray;
+    struct io_uring_sqe *sqes;
+    unsigned sqTailLocal;
+    unsigned toSubmit;
+
+    // completion queue
+    atomic_uint *cqHead, *cqTail;
+    unsigned cqMask;
+    struct io_uring_cqe *cqes;
+
+    void *sqRing, *cqRing;
+    size_t sqRingSize, cqRingSize, sqesSize;
+} uringT;
+
+// ring of provided buffers the kernel picks recv buffers from
+typedef struct uringBufRing {
+    struct io_uring_buf_ring *ring;
+    size_t ringSize;
+    char *bufs;
+    unsigned nBufs;
+    unsigned bufSize;
+    unsigned short groupId;
+    unsigned short tail;
+} uringBufRingT;
+
+bool uringSupported();
+
+uringT *uringNew(unsigned entries);
+
+void uringFree(uringT *ring);
+
+struct io_uring_sqe *uringGetSqe(uringT *ring);
+
+int uringSubmitAndWait(uringT *ring, unsigned waitNr, int timeoutMs);
+
+struct io_uring_cqe *uringPeekCqe(uringT *ring);
+
+void uringCqeSeen(uringT *ring);
+
+uringBufRingT *uringBufRingNew(uringT *ring, unsigned short groupId, unsigned nBufs, unsigned bufSize);
+
+void uringBufRingFree(uringT *ring, uringBufRingT *bufRing);
+
+char *uringBuf(uringBufRingT *bufRing, unsigned short bid);
+
+void uringBufRecycle(uringBufRingT *bufRing, unsigned short bid);
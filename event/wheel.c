@@ -0,0 +1,161 @@
+#include "wheel.h"
+
+#include <limits.h>
+
+#include "../log/log.h"
+
+#define SLOT_MASK (WHEEL_SLOTS - 1)
+// ticks one rotation of the top level spans
+#define WHEEL_SPAN (1ull << (WHEEL_LEVELS * WHEEL_SLOT_BITS))
+
+void place(timerWheelT *wheel, timerT *timer);
+
+void cascade(timerWheelT *wheel, int level);
+
+void unlink_timer(timerT *timer);
+
+timerWheelT *timerWheelNew(long long nowMs) {
+    timerWheelT *wheel = calloc(1, sizeof(timerWheelT));
+    if (wheel == NULL) {
+        logError(ERR_FSTR, "timer wheel alloc failed", strerror(errno));
+        return NULL;
+    }
+    wheel->now = (unsigned long long) nowMs / WHEEL_TICK_MS;
+    for (int level = 0; level < WHEEL_LEVELS; ++level) {
+        for (int i = 0; i < WHEEL_SLOTS; ++i) {
+            timerT *slot = &wheel->slots[level][i];
+            slot->prev = slot;
+            slot->next = slot;
+        }
+    }
+    return wheel;
+}
+
+// timers live in their owners, nothing else to release
+void timerWheelFree(timerWheelT *wheel) {
+    free(wheel);
+}
+
+void timerWheelSchedule(timerWheelT *wheel, timerT *timer, long long deadlineMs) {
+    timerWheelCancel(wheel, timer);
+    if (deadlineMs < 0) {
+        return;
+    }
+    // rounded up so it never fires early, and past the last expired tick whose slot is done already
+    unsigned long long tick = ((unsigned long long) deadlineMs + WHEEL_TICK_MS - 1) / WHEEL_TICK_MS;
+    timer->tick = tick > wheel->now ? tick : wheel->now + 1;
+    place(wheel, timer);
+    wheel->nTimers++;
+}
+
+void timerWheelCancel(timerWheelT *wheel, timerT *timer) {
+    if (timer->next == NULL) {
+        return;
+    }
+    unlink_timer(timer);
+    wheel->nTimers--;
+}
+
+size_t timerWheelAdvance(timerWheelT *wheel, long long nowMs, timerExpireT expire, void *arg) {
+    unsigned long long target = (unsigned long long) nowMs / WHEEL_TICK_MS;
+    size_t expired = 0;
+    while (wheel->now < target) {
+        if (wheel->nTimers == 0) {
+            wheel->now = target;
+            break;
+        }
+        unsigned long long tick = ++wheel->now;
+
+        // a level turns to its next slot when every level below it wraps around, the highest one goes first
+        int top = 0;
+        while (top + 1 < WHEEL_LEVELS && (tick & ((1ull << ((top + 1) * WHEEL_SLOT_BITS)) - 1)) == 0) {
+            top++;
+        }
+        for (int level = top; level > 0; --level) {
+            cascade(wheel, level);
+        }
+
+        // timers scheduled by expire land in later ticks, never in this slot
+        timerT *slot = &wheel->slots[0][tick & SLOT_MASK];
+        while (slot->next != slot) {
+            timerT *timer = slot->next;
+            unlink_timer(timer);
+            wheel->nTimers--;
+            expired++;
+            expire(timer, arg);
+        }
+    }
+    return expired;
+}
+
+int timerWheelTimeout(const timerWheelT *wheel, long long nowMs) {
+    if (wheel->nTimers == 0) {
+        return -1;
+    }
+
+    // the bottom level holds the ticks left in its rotation, anything later waits for the next cascade
+    unsigned long long next = (wheel->now | SLOT_MASK) + 1;
+    for (unsigned long long tick = wheel->now + 1; tick < next; ++tick) {
+        const timerT *slot = &wheel->slots[0][tick & SLOT_MASK];
+        if (slot->next != slot) {
+            next = tick;
+            break;
+        }
+    }
+
+    long long left = (long long) (next * WHEEL_TICK_MS) - nowMs;
+    if (left <= 0) {
+        return 0;
+    }
+    return left < INT_MAX ? (int) left : INT_MAX;
+}
+
+// the level is the highest slot group tick differs in from now, so a timer reaches the bottom level
+// by the time its tick comes
+void place(timerWheelT *wheel, timerT *timer) {
+    unsigned long long diff = timer->tick ^ wheel->now;
+    int level = diff == 0 ? 0 : (63 - __builtin_clzll(diff)) / WHEEL_SLOT_BITS;
+    unsigned long long at = timer->tick;
+    if (level >= WHEEL_LEVELS) {
+        // past the top level: its slot is turned a rotation from now at the latest, and placed again from there
+        level = WHEEL_LEVELS - 1;
+        if (at - wheel->now >= WHEEL_SPAN) {
+            at = wheel->now + WHEEL_SPAN;
+        }
+    }
+
+    timerT *slot = &wheel->slots[level][(at >> (level * WHEEL_SLOT_BITS)) & SLOT_MASK];
+    timer->prev = slot->prev;
+    timer->next = slot;
+    slot->prev->next = timer;
+    slot->prev = timer;
+}
+
+// moves the timers of the slot level just turned to into the levels below it
+void cascade(timerWheelT *wheel, int level) {
+    timerT *slot = &wheel->slots[level][(wheel->now >> (level * WHEEL_SLOT_BITS)) & SLOT_MASK];
+    timerT pending = {.prev = &pending, .next = &pending};
+    if (slot->next == slot) {
+        return;
+    }
+    // detached first: a parked timer may land in this very slot again
+    pending.next = slot->next;
+    pending.prev = slot->prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    slot->next = slot;
+    slot->prev = slot;
+
+    while (pending.next != &pending) {
+        timerT *timer = pending.next;
+        unlink_timer(timer);
+        place(wheel, timer);
+    }
+}
+
+void unlink_timer(timerT *timer) {
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = NULL;
+    timer->next = NULL;
+}
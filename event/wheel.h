@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// resolution of the wheel, deadlines never fire early but up to a tick late
+#define WHEEL_TICK_MS 100
+// 64 slots per level, 4 levels cover 2^24 ticks (about 19 days), later deadlines are parked at the top level
+#define WHEEL_SLOT_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_SLOT_BITS)
+#define WHEEL_LEVELS 4
+
+typedef struct timer timerT;
+
+// intrusive timer, embedded in the object it expires; zeroed means not scheduled
+struct timer {
+    timerT *prev, *next;
+    unsigned long long tick;
+    void *data;
+};
+
+typedef void (*timerExpireT)(timerT *timer, void *arg);
+
+// hierarchical timing wheel: scheduling, cancelling and expiring a timer are O(1), a level is cascaded
+// into the one below it once per rotation of that level; it has one owner thread, nothing is locked
+typedef struct timerWheel {
+    // last tick expired
+    unsigned long long now;
+    size_t nTimers;
+    // circular lists with the slot itself as the sentinel
+    timerT slots[WHEEL_LEVELS][WHEEL_SLOTS];
+} timerWheelT;
+
+timerWheelT *timerWheelNew(long long nowMs);
+
+void timerWheelFree(timerWheelT *wheel);
+
+// (re)schedules timer to fire once the clock reaches deadlineMs, a negative deadline cancels it
+void timerWheelSchedule(timerWheelT *wheel, timerT *timer, long long deadlineMs);
+
+void timerWheelCancel(timerWheelT *wheel, timerT *timer);
+
+// expires every timer due by nowMs, each one is unscheduled before expire is called with it;
+// returns how many expired
+size_t timerWheelAdvance(timerWheelT *wheel, long long nowMs, timerExpireT expire, void *arg);
+
+// milliseconds until the wheel has work to do, -1 when nothing is scheduled
+int timerWheelTimeout(const timerWheelT *wheel, long long nowMs);
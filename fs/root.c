@@ -0,0 +1,111 @@
+#define _GNU_SOURCE
+
+#include "root.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#ifdef SYS_openat2
+#include <linux/openat2.h>
+#endif
+
+#include "../log/log.h"
+
+int open_walk(int rootFd, const char *path, int flags);
+
+// cleared on the first ENOSYS
+atomic_bool openat2_works = true;
+
+int rootDirOpen(const char *path) {
+    int fd = open(path, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        logFatal(ERR_FSTR, "Failed to open root dir", strerror(errno));
+    }
+    return fd;
+}
+
+int rootOpen(int rootFd, const char *path, int flags) {
+#ifdef SYS_openat2
+    if (atomic_load_explicit(&openat2_works, memory_order_relaxed)) {
+        // a single lookup: the kernel keeps the walk beneath rootFd and refuses /proc style magic links
+        struct open_how how = {
+                .flags = (unsigned long long) (flags | O_CLOEXEC),
+                .resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS,
+        };
+        int fd = (int) syscall(SYS_openat2, rootFd, path, &how, sizeof(how));
+        if (fd >= 0 || errno != ENOSYS) {
+            return fd;
+        }
+        atomic_store(&openat2_works, false);
+        logWarn("openat2 is not supported, falling back to a component-wise walk");
+    }
+#endif
+    return open_walk(rootFd, path, flags);
+}
+
+int rootFdPath(int fd, char *buff, size_t size) {
+    char link[32];
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    ssize_t len = readlink(link, buff, size);
+    if (len < 0 || (size_t) len >= size) {
+        return -1;
+    }
+    buff[len] = '\0';
+    return 0;
+}
+
+// one openat per component, stricter than RESOLVE_BENEATH: ".." and symlinks are refused instead of resolved
+int open_walk(int rootFd, const char *path, int flags) {
+    if (path[0] == '/') {
+        errno = EXDEV;
+        return -1;
+    }
+
+    char name[NAME_MAX + 1];
+    int dir = rootFd;
+    const char *ptr = path;
+    while (true) {
+        const char *end = strchrnul(ptr, '/');
+        const char *next = end;
+        while (*next == '/') {
+            next++;
+        }
+        bool last = *next == '\0';
+
+        size_t len = end - ptr;
+        int err = len > NAME_MAX ? ENAMETOOLONG : len == 2 && ptr[0] == '.' && ptr[1] == '.' ? EXDEV : 0;
+        if (err != 0) {
+            if (dir != rootFd) {
+                close(dir);
+            }
+            errno = err;
+            return -1;
+        }
+        memcpy(name, ptr, len);
+        name[len] = '\0';
+
+        if (!last && (len == 0 || strcmp(name, ".") == 0)) {
+            ptr = next;
+            continue;
+        }
+
+        int fd = last ? openat(dir, len > 0 ? name : ".", flags | O_NOFOLLOW | O_CLOEXEC)
+                      : openat(dir, name, O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        err = errno;
+        if (dir != rootFd) {
+            close(dir);
+        }
+        if (fd < 0 || last) {
+            errno = err;
+            return fd;
+        }
+        dir = fd;
+        ptr = next;
+    }
+}
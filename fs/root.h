@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// O_PATH descriptor of the document root, every file is opened relative to it
+int rootDirOpen(const char *path);
+
+// opens path (relative to the root) without ever resolving outside of it: absolute paths, ".." or symlinks
+// leading out fail with EXDEV; openat2(RESOLVE_BENEATH) when the kernel has it, a component-wise walk before 5.6
+int rootOpen(int rootFd, const char *path, int flags);
+
+// absolute path of an open descriptor
+int rootFdPath(int fd, char *buff, size_t size);
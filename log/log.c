@@ -1,24 +1,82 @@
 #include "log.h"
 
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
 #define STDOUT_FD 1
 
+// records buffered per thread, a record holds one formatted message
+#define LOG_RING_SIZE 1024
+#define LOG_MSG_LEN 224
+#define LOG_THREAD_LEN 16
+#define LOG_BATCH_SIZE 65536
+#define LOG_FLUSH_MS 10
+#define LOG_STAMP_LEN 20
+
 thread_local const char *threadName = "main";
 
 const char *log_level_str[] = {"FATAL", "ERROR", "WARN", "INFO", "DEBUG", "TRACE"};
 
+typedef struct log_record {
+    time_t time;
+    logLevelT level;
+    char thread[LOG_THREAD_LEN];
+    char msg[LOG_MSG_LEN];
+} log_record_t;
+
+// single producer (the owning thread), single consumer (the flusher)
+typedef struct log_ring log_ring_t;
+
+struct log_ring {
+    _Alignas(64) atomic_size_t head;
+    _Alignas(64) atomic_size_t tail;
+    atomic_bool closed;
+    log_ring_t *next;
+    log_record_t records[LOG_RING_SIZE];
+};
+
 typedef struct logger {
     logLevelT level;
+    logPolicyT policy;
     int fd;
-    pthread_mutex_t *mutex;
+
+    // guards the ring list and synchronous writes
+    pthread_mutex_t mutex;
+    log_ring_t *rings;
+    pthread_key_t ringKey;
+
+    pthread_t flusher;
+    atomic_bool running;
+    atomic_bool stopping;
+    atomic_ullong dropped;
+
+    // wall clock rendered once per second by the flusher
+    time_t stampTime;
+    char stamp[LOG_STAMP_LEN];
 } logger_t;
 
-logger_t logger;
+logger_t logger = {.level = INFO, .fd = STDOUT_FD, .mutex = PTHREAD_MUTEX_INITIALIZER};
+
+thread_local log_ring_t *thread_ring = NULL;
 
 void print(const char *fstr, logLevelT level, va_list argptr);
 
-int print_file(const char *fstr, logLevelT level, va_list argptr);
+log_ring_t *get_ring();
+
+void close_ring(void *ring);
+
+void *flusher_routine(void *arg);
 
-void print_stdout(const char *fstr, logLevelT level, va_list argptr);
+size_t drain_rings();
+
+size_t format_record(char *buff, size_t size, const log_record_t *record, const char *stamp);
+
+void render_stamp(time_t t, char *stamp);
+
+void write_all(const char *buff, size_t len);
 
 const char *ltostr(logLevelT);
 
@@ -26,19 +84,51 @@ int logInit() {
     logger.fd = STDOUT_FD;
     logger.level = INFO;
 
-    logger.mutex = calloc(1, sizeof(pthread_mutex_t));
-    if (logger.mutex == NULL) {
-        printf("log init failed: mutex allocate failed\n");
+    if (pthread_key_create(&logger.ringKey, close_ring) != 0) {
+        printf("log init failed: pthread_key_create failed\n");
         return -1;
     }
 
-    pthread_mutex_init(logger.mutex, NULL);
+    atomic_store(&logger.stopping, false);
+    if (pthread_create(&logger.flusher, NULL, flusher_routine, NULL) != 0) {
+        printf("log init failed: flusher thread not started\n");
+        pthread_key_delete(logger.ringKey);
+        return -1;
+    }
+    atomic_store(&logger.running, true);
 
     return 0;
 }
 
+// flushes everything buffered, later messages are written synchronously
 void logFree() {
-    free(logger.mutex);
+    if (!atomic_exchange(&logger.running, false)) {
+        return;
+    }
+    atomic_store(&logger.stopping, true);
+    pthread_join(logger.flusher, NULL);
+    drain_rings();
+
+    unsigned long long dropped = atomic_load(&logger.dropped);
+    if (dropped > 0) {
+        dprintf(logger.fd, "log: %llu messages dropped\n", dropped);
+    }
+
+    // rings of live threads stay allocated, their owners may still log
+    pthread_mutex_lock(&logger.mutex);
+    // ===== CRITICAL SECTION =====
+    log_ring_t **link = &logger.rings;
+    while (*link != NULL) {
+        log_ring_t *ring = *link;
+        if (atomic_load(&ring->closed)) {
+            *link = ring->next;
+            free(ring);
+        } else {
+            link = &ring->next;
+        }
+    }
+    // ============================
+    pthread_mutex_unlock(&logger.mutex);
 }
 
 void logSetFd(int fd) {
@@ -49,6 +139,10 @@ void logSetLevel(logLevelT level) {
     logger.level = level;
 }
 
+void logSetPolicy(logPolicyT policy) {
+    logger.policy = policy;
+}
+
 void logDebug(const char *fstr, ...) {
     if (logger.level >= DEBUG) {
         va_list argptr;
@@ -104,68 +198,171 @@ void logTrace(const char *fstr, ...) {
 }
 
 void print(const char *fstr, logLevelT level, va_list argptr) {
-//    if (print_file(fstr, level, argptr) < 0) {
-    print_stdout(fstr, level, argptr);
-//    }
-}
+    log_ring_t *ring = atomic_load(&logger.running) ? get_ring() : NULL;
+    if (ring == NULL) {
+        // logger not running: format and write in place
+        log_record_t record = {.time = time(NULL), .level = level};
+        strncpy(record.thread, threadName, LOG_THREAD_LEN - 1);
+        vsnprintf(record.msg, LOG_MSG_LEN, fstr, argptr);
 
-int print_file(const char *fstr, logLevelT level, va_list argptr) {
+        char stamp[LOG_STAMP_LEN];
+        char buff[LOG_MSG_LEN + 64];
+        render_stamp(record.time, stamp);
+        size_t len = format_record(buff, sizeof(buff), &record, stamp);
 
-    time_t t = time(NULL);
-    struct tm local;
-    localtime_r(&t, &local);
+        pthread_mutex_lock(&logger.mutex);
+        // ===== CRITICAL SECTION =====
+        write_all(buff, len);
+        // ============================
+        pthread_mutex_unlock(&logger.mutex);
+        return;
+    }
 
-    pthread_mutex_lock(logger.mutex);
-    // ===== CRITICAL SECTION =====
-    if (dprintf(logger.fd, "[%02d/%02d/%dT%02d:%02d:%02d] --- [%s] --- [%s] --- ", local.tm_mday, local.tm_mon + 1,
-                local.tm_year + 1900, local.tm_hour, local.tm_min, local.tm_sec, threadName,
-                ltostr(level)) < 0) {
-        pthread_mutex_unlock(logger.mutex);
-        return -1;
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&ring->head, memory_order_acquire) >= LOG_RING_SIZE) {
+        // fatal messages are never lost
+        if (logger.policy == LOG_DROP && level != FATAL) {
+            atomic_fetch_add_explicit(&logger.dropped, 1, memory_order_relaxed);
+            return;
+        }
+        if (!atomic_load(&logger.running)) {
+            return;
+        }
+        sched_yield();
     }
 
-    if (vdprintf(logger.fd, fstr, argptr) < 0) {
-        pthread_mutex_unlock(logger.mutex);
-        return -1;
+    log_record_t *record = &ring->records[tail % LOG_RING_SIZE];
+    record->time = time(NULL);
+    record->level = level;
+    strncpy(record->thread, threadName, LOG_THREAD_LEN - 1);
+    record->thread[LOG_THREAD_LEN - 1] = '\0';
+    vsnprintf(record->msg, LOG_MSG_LEN, fstr, argptr);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+log_ring_t *get_ring() {
+    if (thread_ring != NULL) {
+        return thread_ring;
     }
-    int rc = dprintf(logger.fd, "\n");
+
+    log_ring_t *ring = calloc(1, sizeof(log_ring_t));
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&logger.mutex);
+    // ===== CRITICAL SECTION =====
+    ring->next = logger.rings;
+    logger.rings = ring;
     // ============================
-    pthread_mutex_unlock(logger.mutex);
+    pthread_mutex_unlock(&logger.mutex);
 
-    return rc;
+    pthread_setspecific(logger.ringKey, ring);
+    thread_ring = ring;
+    return ring;
 }
 
-void print_stdout(const char *fstr, logLevelT level, va_list argptr) {
-    time_t t = time(NULL);
-    struct tm *local = localtime(&t);
+// thread exit: the flusher frees the ring once it is drained
+void close_ring(void *ring) {
+    atomic_store(&((log_ring_t *) ring)->closed, true);
+}
+
+void *flusher_routine(void *arg) {
+    (void) arg;
+    struct timespec pause = {.tv_sec = 0, .tv_nsec = LOG_FLUSH_MS * 1000000L};
+
+    while (!atomic_load(&logger.stopping)) {
+        if (drain_rings() == 0) {
+            nanosleep(&pause, NULL);
+        }
+    }
+    return NULL;
+}
+
+// writes out all buffered records in batches, returns their number
+size_t drain_rings() {
+    static char batch[LOG_BATCH_SIZE];
+    size_t batch_len = 0;
+    size_t total = 0;
 
-    pthread_mutex_lock(logger.mutex);
+    pthread_mutex_lock(&logger.mutex);
     // ===== CRITICAL SECTION =====
-    if (level == ERROR) {
-        printf("%02d-%02d-%d %02d:%02d:%02d \033[1;31m%-5s\033[0m %s ",
-               local->tm_mday, local->tm_mon + 1, local->tm_year + 1900,
-               local->tm_hour, local->tm_min, local->tm_sec,
-               ltostr(level), threadName);
-    } else if (level == INFO) {
-        printf("%02d-%02d-%d %02d:%02d:%02d \033[0;34m%-5s\033[0m %s ",
-               local->tm_mday, local->tm_mon + 1, local->tm_year + 1900,
-               local->tm_hour, local->tm_min, local->tm_sec,
-               ltostr(level), threadName);
-    } else if (level == WARN) {
-        printf("%02d-%02d-%d %02d:%02d:%02d \033[0;33m%-5s\033[0m %s ",
-               local->tm_mday, local->tm_mon + 1, local->tm_year + 1900,
-               local->tm_hour, local->tm_min, local->tm_sec,
-               ltostr(level), threadName);
-    } else {
-        printf("%02d-%02d-%d %02d:%02d:%02d %-5s %s ",
-               local->tm_mday, local->tm_mon + 1, local->tm_year + 1900,
-               local->tm_hour, local->tm_min, local->tm_sec,
-               ltostr(level), threadName);
-    }
-    vprintf(fstr, argptr);
-    printf("\n");
+    log_ring_t **link = &logger.rings;
+    while (*link != NULL) {
+        log_ring_t *ring = *link;
+        bool closed = atomic_load(&ring->closed);
+
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        for (; head != tail; ++head) {
+            const log_record_t *record = &ring->records[head % LOG_RING_SIZE];
+            if (record->time != logger.stampTime) {
+                logger.stampTime = record->time;
+                render_stamp(record->time, logger.stamp);
+            }
+
+            if (LOG_BATCH_SIZE - batch_len < LOG_MSG_LEN + 64) {
+                write_all(batch, batch_len);
+                batch_len = 0;
+            }
+            batch_len += format_record(batch + batch_len, LOG_BATCH_SIZE - batch_len, record, logger.stamp);
+        }
+        total += tail - atomic_load_explicit(&ring->head, memory_order_relaxed);
+        atomic_store_explicit(&ring->head, tail, memory_order_release);
+
+        if (closed && tail == atomic_load(&ring->tail)) {
+            *link = ring->next;
+            free(ring);
+        } else {
+            link = &ring->next;
+        }
+    }
+    write_all(batch, batch_len);
     // ============================
-    pthread_mutex_unlock(logger.mutex);
+    pthread_mutex_unlock(&logger.mutex);
+
+    return total;
+}
+
+size_t format_record(char *buff, size_t size, const log_record_t *record, const char *stamp) {
+    const char *color;
+    switch (record->level) {
+        case ERROR:
+            color = "\033[1;31m";
+            break;
+        case INFO:
+            color = "\033[0;34m";
+            break;
+        case WARN:
+            color = "\033[0;33m";
+            break;
+        default:
+            color = "";
+    }
+
+    int len = snprintf(buff, size, "%s %s%-5s%s %s %s\n", stamp, color, ltostr(record->level),
+                       *color != '\0' ? "\033[0m" : "", record->thread, record->msg);
+    if (len < 0) {
+        return 0;
+    }
+    return (size_t) len < size ? (size_t) len : size - 1;
+}
+
+void render_stamp(time_t t, char *stamp) {
+    struct tm local;
+    localtime_r(&t, &local);
+    strftime(stamp, LOG_STAMP_LEN, "%d-%m-%Y %H:%M:%S", &local);
+}
+
+void write_all(const char *buff, size_t len) {
+    while (len > 0) {
+        ssize_t written = write(logger.fd, buff, len);
+        if (written <= 0) {
+            return;
+        }
+        buff += written;
+        len -= (size_t) written;
+    }
 }
 
 const char *ltostr(logLevelT level) {
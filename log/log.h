@@ -14,6 +14,11 @@ typedef enum logLevel {
     FATAL = 0, ERROR, WARN, INFO, DEBUG, TRACE
 } logLevelT;
 
+// what a thread does when its log ring is full
+typedef enum logPolicy {
+    LOG_DROP = 0, LOG_BLOCK
+} logPolicyT;
+
 int logInit();
 
 void logFree();
@@ -22,6 +27,8 @@ void logSetFd(int fd);
 
 void logSetLevel(logLevelT level);
 
+void logSetPolicy(logPolicyT policy);
+
 void logDebug(const char *fstr, ...);
 
 void logInfo(const char *fstr, ...);
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <signal.h>
+#include <getopt.h>
 
 #include "constants.h"
 #include "server/server.h"
@@ -11,13 +12,201 @@ httpServerT *server = NULL;
 void sigHandler(int signum) {
     printf("received signal %d\n", signum);
     httpServerFree(server);
+    logFree();
     exit(0);
 }
 
-int main() {
+void usage(const char *prog) {
+    printf("usage: %s [-p port] [-t threads] [-m pool|reuseport|uring] [-w scheduler] [-e epoll|poll] [-E] [-k seconds] [-r requests] [-R seconds] [-W seconds] [-n connections] [-q ms] [-D seconds] [-F queue] [-b kilobytes] [-s mode] [-c megabytes] [-f entries] [-z megabytes] [-M path]\n", prog);
+    printf("  -m  pool: event loop + thread pool, reuseport: event loop per thread,\n");
+    printf("      uring: io_uring loop per thread, falls back to reuseport (default: %s)\n", serverMode);
+    printf("  -w  pool scheduler: shared, roundrobin or leastloaded (default: %s)\n", poolScheduler);
+    printf("  -e  event loop engine (default: %s)\n", eventEngine);
+    printf("  -E  edge-triggered epoll\n");
+    printf("  -k  keep-alive idle timeout, 0 disables keep-alive (default: %d)\n", keepAliveTimeout);
+    printf("  -r  max requests per connection, 0 is unlimited (default: %d)\n", keepAliveMax);
+    printf("  -R  seconds to receive a request header block, 0 disables (default: %d)\n", headerTimeout);
+    printf("  -W  seconds a response may make no progress, 0 disables (default: %d)\n", sendTimeout);
+    printf("  -n  max open connections, 0 leaves the fd limit (default: %d)\n", maxConnections);
+    printf("  -q  pool queue wait target in ms to shed load above, 0 disables (default: %d)\n", queueTargetMs);
+    printf("  -D  TCP_DEFER_ACCEPT seconds, 0 disables (default: %d)\n", deferAccept);
+    printf("  -F  TCP_FASTOPEN queue length, 0 disables (default: %d)\n", fastOpenQueue);
+    printf("  -b  socket send buffer per connection, 0 leaves it to the kernel (default: %d)\n", sendBufferKb);
+    printf("  -s  file transmission: sendfile, splice or copy (default: %s)\n", sendMode);
+    printf("  -c  hot-file cache size, 0 disables the cache (default: %d)\n", cacheBudgetMb);
+    printf("  -f  open file cache entries, 0 disables the cache (default: %d)\n", fileCacheEntries);
+    printf("  -z  compressed variant cache size, 0 serves only .br/.gz sidecars (default: %d)\n", compressBudgetMb);
+    printf("  -M  metrics url, empty disables it (default: %s)\n", metricsPath);
+}
+
+int parse_mode(const char *name, serverModeT *mode) {
+    if (strcmp(name, "pool") == 0) {
+        *mode = SERVER_POOL;
+    } else if (strcmp(name, "reuseport") == 0) {
+        *mode = SERVER_REUSEPORT;
+    } else if (strcmp(name, "uring") == 0) {
+        *mode = SERVER_URING;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int parse_sched(const char *name, tPoolSchedT *sched) {
+    if (strcmp(name, "shared") == 0) {
+        *sched = TPOOL_SHARED;
+    } else if (strcmp(name, "roundrobin") == 0) {
+        *sched = TPOOL_ROUND_ROBIN;
+    } else if (strcmp(name, "leastloaded") == 0) {
+        *sched = TPOOL_LEAST_LOADED;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int parse_engine(const char *name, pollerTypeT *engine) {
+    if (strcmp(name, "epoll") == 0) {
+        *engine = POLLER_EPOLL;
+    } else if (strcmp(name, "poll") == 0) {
+        *engine = POLLER_POLL;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int parse_send_mode(const char *name, sendModeT *mode) {
+    if (strcmp(name, "sendfile") == 0) {
+        *mode = SEND_SENDFILE;
+    } else if (strcmp(name, "splice") == 0) {
+        *mode = SEND_SPLICE;
+    } else if (strcmp(name, "copy") == 0) {
+        *mode = SEND_COPY;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+int parse_args(int argc, char *argv[], httpServerConfigT *config) {
+    int opt;
+    while ((opt = getopt(argc, argv, "p:t:m:w:e:Ek:r:R:W:n:q:D:F:b:s:c:f:z:M:h")) != -1) {
+        switch (opt) {
+            case 'p':
+                config->port = atoi(optarg);
+                break;
+            case 't':
+                config->nThreads = atoi(optarg);
+                break;
+            case 'm':
+                if (parse_mode(optarg, &config->mode) < 0) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'w':
+                if (parse_sched(optarg, &config->sched) < 0) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'e':
+                if (parse_engine(optarg, &config->engine) < 0) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'E':
+                config->edgeTriggered = true;
+                break;
+            case 'k':
+                config->keepAliveTimeout = atoi(optarg);
+                break;
+            case 'r':
+                config->keepAliveMax = atoi(optarg);
+                break;
+            case 'R':
+                config->headerTimeout = atoi(optarg);
+                break;
+            case 'W':
+                config->sendTimeout = atoi(optarg);
+                break;
+            case 'n':
+                config->maxConns = atoi(optarg);
+                break;
+            case 'q':
+                config->queueTargetMs = atoi(optarg);
+                break;
+            case 'D':
+                config->deferAccept = atoi(optarg);
+                break;
+            case 'F':
+                config->fastOpenQueue = atoi(optarg);
+                break;
+            case 'b':
+                config->sendBuffer = atoi(optarg) * 1024;
+                break;
+            case 's':
+                if (parse_send_mode(optarg, &config->sendMode) < 0) {
+                    usage(argv[0]);
+                    return -1;
+                }
+                break;
+            case 'c':
+                config->cacheBudget = (size_t) atoi(optarg) * 1024 * 1024;
+                break;
+            case 'f':
+                config->fileCacheEntries = atoi(optarg);
+                break;
+            case 'z':
+                config->compressBudget = (size_t) atoi(optarg) * 1024 * 1024;
+                break;
+            case 'M':
+                config->metricsPath = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
     setbuf(stdout, NULL);
     printf("pid: %d\n", getpid());
 
+    httpServerConfigT config = {
+            .host = ipAddress,
+            .port = port,
+            .nThreads = nThreads,
+            .wd = wd,
+            .edgeTriggered = edgeTriggered,
+            .keepAliveTimeout = keepAliveTimeout,
+            .keepAliveMax = keepAliveMax,
+            .headerTimeout = headerTimeout,
+            .sendTimeout = sendTimeout,
+            .maxConns = maxConnections,
+            .queueTargetMs = queueTargetMs,
+            .deferAccept = deferAccept,
+            .fastOpenQueue = fastOpenQueue,
+            .sendBuffer = sendBufferKb * 1024,
+            .cacheBudget = (size_t) cacheBudgetMb * 1024 * 1024,
+            .cacheMaxObject = (size_t) cacheMaxFileKb * 1024,
+            .cacheAdmitHits = cacheAdmitHits,
+            .fileCacheEntries = fileCacheEntries,
+            .compressBudget = (size_t) compressBudgetMb * 1024 * 1024,
+            .metricsPath = metricsPath,
+    };
+    parse_mode(serverMode, &config.mode);
+    parse_sched(poolScheduler, &config.sched);
+    parse_engine(eventEngine, &config.engine);
+    parse_send_mode(sendMode, &config.sendMode);
+    if (parse_args(argc, argv, &config) < 0) {
+        return -1;
+    }
+
     // Logger
     if (logInit() < 0) {
         return -1;
@@ -31,7 +220,7 @@ int main() {
     signal(SIGHUP, sigHandler);
     signal(SIGPIPE, SIG_IGN);
 
-    server = httpServerNew(ipAddress, port, nThreads, wd);
+    server = httpServerNew(&config);
     if(server == NULL) {
         return -1;
     }
@@ -39,5 +228,6 @@ int main() {
         httpServerFree(server);
     }
 
+    logFree();
     return 0;
 }
@@ -0,0 +1,48 @@
+#include "alloc_stats.h"
+
+#include <stddef.h>
+#include <threads.h>
+
+#ifdef ALLOC_STATS
+
+// malloc and friends are interposed on the glibc allocator, anything linked in that allocates is counted
+extern void *__libc_malloc(size_t size);
+
+extern void *__libc_calloc(size_t n, size_t size);
+
+extern void *__libc_realloc(void *ptr, size_t size);
+
+extern void __libc_free(void *ptr);
+
+thread_local unsigned long long thread_allocs = 0;
+
+void *malloc(size_t size) {
+    thread_allocs++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    thread_allocs++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    thread_allocs++;
+    return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+    __libc_free(ptr);
+}
+
+unsigned long long allocCount() {
+    return thread_allocs;
+}
+
+#else
+
+unsigned long long allocCount() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,4 @@
+#pragma once
+
+// heap allocations made by the calling thread so far; counted in debug builds (ALLOC_STATS), always 0 otherwise
+unsigned long long allocCount();
@@ -0,0 +1,74 @@
+#include "slab.h"
+
+#include <stdalign.h>
+
+#include "../log/log.h"
+
+struct slabChunk {
+    slabChunkT *next;
+    alignas(max_align_t) char objects[];
+};
+
+int grow(slabT *slab);
+
+slabT *slabNew(size_t objSize) {
+    slabT *slab = calloc(1, sizeof(slabT));
+    if (slab == NULL) {
+        logError(ERR_FSTR, "slab alloc failed", strerror(errno));
+        return NULL;
+    }
+    // a free object holds the free list link, and every object stays aligned inside its chunk
+    size_t align = alignof(max_align_t);
+    size_t size = objSize < sizeof(void *) ? sizeof(void *) : objSize;
+    slab->objSize = (size + align - 1) / align * align;
+    return slab;
+}
+
+void slabFree(slabT *slab) {
+    if (slab->nUsed > 0) {
+        logWarn("slab freed with %zu objects in use", slab->nUsed);
+    }
+    slabChunkT *chunk = slab->chunks;
+    while (chunk != NULL) {
+        slabChunkT *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(slab);
+}
+
+void *slabAlloc(slabT *slab) {
+    if (slab->freeList == NULL && grow(slab) < 0) {
+        return NULL;
+    }
+    void *obj = slab->freeList;
+    slab->freeList = *(void **) obj;
+    slab->nUsed++;
+    memset(obj, 0, slab->objSize);
+    return obj;
+}
+
+void slabRelease(slabT *slab, void *obj) {
+    *(void **) obj = slab->freeList;
+    slab->freeList = obj;
+    slab->nUsed--;
+}
+
+// threads a new chunk onto the free list
+int grow(slabT *slab) {
+    slabChunkT *chunk = malloc(sizeof(slabChunkT) + SLAB_CHUNK * slab->objSize);
+    if (chunk == NULL) {
+        logError(ERR_FSTR, "slab chunk alloc failed", strerror(errno));
+        return -1;
+    }
+    chunk->next = slab->chunks;
+    slab->chunks = chunk;
+    slab->nChunks++;
+
+    for (int i = SLAB_CHUNK - 1; i >= 0; --i) {
+        void *obj = chunk->objects + (size_t) i * slab->objSize;
+        *(void **) obj = slab->freeList;
+        slab->freeList = obj;
+    }
+    return 0;
+}
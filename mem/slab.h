@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// objects per chunk the slab grows by
+#define SLAB_CHUNK 64
+
+typedef struct slabChunk slabChunkT;
+
+// fixed-size objects carved from chunks, freed ones are reused before the slab grows;
+// it has one owner thread, nothing is locked
+typedef struct slab {
+    size_t objSize;
+    void *freeList;
+    slabChunkT *chunks;
+    size_t nChunks;
+    size_t nUsed;
+} slabT;
+
+slabT *slabNew(size_t objSize);
+
+// every object must be released already
+void slabFree(slabT *slab);
+
+// zeroed object, NULL when the slab could not grow
+void *slabAlloc(slabT *slab);
+
+void slabRelease(slabT *slab, void *obj);
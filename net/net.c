@@ -1,6 +1,14 @@
 #include "net.h"
 
-int netListen(char *host, int port) {
+ssize_t send_copy(int sock, int fd, off_t *offset, size_t count);
+
+ssize_t send_splice(int sock, int fd, int pipefd[2], off_t *piped, off_t *offset, size_t count);
+
+thread_local char copy_buf[RESP_SIZE];
+
+thread_local unsigned long long send_calls = 0;
+
+int netListen(char *host, int port, bool reusePort, int deferAcceptSec, int fastOpenQueue, int sendBuffer) {
     int listenfd = socket(AF_INET, SOCK_STREAM, 0);
     if (listenfd < 0) {
         logFatal(ERR_FSTR, "socket create failed", strerror(errno));
@@ -8,6 +16,12 @@ int netListen(char *host, int port) {
     }
     int option = 1;
     setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+    // several listeners on one port, the kernel balances connections between them
+    if (reusePort && setsockopt(listenfd, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option)) != 0) {
+        logFatal(ERR_FSTR, "SO_REUSEPORT failed", strerror(errno));
+        close(listenfd);
+        return -1;
+    }
 
     struct sockaddr_in addr;
     addr.sin_family = AF_INET;
@@ -15,24 +29,50 @@ int netListen(char *host, int port) {
     addr.sin_addr.s_addr = inet_addr(host);
     if (bind(listenfd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
         logFatal(ERR_FSTR, "bind failed", strerror(errno));
+        close(listenfd);
         return -1;
     }
 
+    // the connection is accepted with its request already received, the first read finds it
+    if (deferAcceptSec > 0 &&
+        setsockopt(listenfd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &deferAcceptSec, sizeof(deferAcceptSec)) != 0) {
+        logWarn(ERR_FSTR, "TCP_DEFER_ACCEPT failed", strerror(errno));
+    }
+    // set before listen; the server side also has to be enabled in net.ipv4.tcp_fastopen
+    if (fastOpenQueue > 0 &&
+        setsockopt(listenfd, IPPROTO_TCP, TCP_FASTOPEN, &fastOpenQueue, sizeof(fastOpenQueue)) != 0) {
+        logWarn(ERR_FSTR, "TCP_FASTOPEN failed", strerror(errno));
+    }
+    // accepted sockets inherit it, with autotuning off for them
+    if (sendBuffer > 0 && setsockopt(listenfd, SOL_SOCKET, SO_SNDBUF, &sendBuffer, sizeof(sendBuffer)) != 0) {
+        logWarn(ERR_FSTR, "SO_SNDBUF failed", strerror(errno));
+    }
+
     if (listen(listenfd, SOMAXCONN) != 0) {
         logFatal(ERR_FSTR, "listen failed", strerror(errno));
+        close(listenfd);
         return -1;
     }
     return listenfd;
 }
 
 int netAccept(int listen_sock) {
-    int rc = accept(listen_sock, NULL, 0);
-    if (rc < 0) {
+    int rc = accept4(listen_sock, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (rc < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
         logError(ERR_FSTR, "accept error", strerror(errno));
     }
     return rc;
 }
 
+int netSetNonBlock(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        logError(ERR_FSTR, "fcntl O_NONBLOCK failed", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
 ssize_t netWrite(int fd, const void *buf, size_t n) {
     logDebug("before write to fd = %d", fd);
     ssize_t byte_write = write(fd, buf, n);
@@ -45,8 +85,122 @@ ssize_t netWrite(int fd, const void *buf, size_t n) {
 
 ssize_t netRead(int fd, void *buf, size_t n) {
     ssize_t byte_read = read(fd, buf, n);
-    if (byte_read < 0) {
+    if (byte_read < 0 && errno != EAGAIN) {
         logError(ERR_FSTR, "read error", strerror(errno));
     }
     return byte_read;
 }
+
+// one gathered write, msg is advanced past what the socket took;
+// returns -1 with errno EAGAIN when the socket buffer is full
+ssize_t netSendMsg(int fd, struct msghdr *msg, int flags) {
+    ssize_t byte_write;
+    do {
+        send_calls++;
+        byte_write = sendmsg(fd, msg, flags | MSG_NOSIGNAL);
+    } while (byte_write < 0 && errno == EINTR);
+    if (byte_write < 0) {
+        if (errno != EAGAIN) {
+            logError(ERR_FSTR, "sendmsg error", strerror(errno));
+        }
+        return -1;
+    }
+
+    size_t left = byte_write;
+    while (msg->msg_iovlen > 0 && left >= msg->msg_iov->iov_len) {
+        left -= msg->msg_iov->iov_len;
+        msg->msg_iov++;
+        msg->msg_iovlen--;
+    }
+    if (msg->msg_iovlen > 0) {
+        msg->msg_iov->iov_base = (char *) msg->msg_iov->iov_base + left;
+        msg->msg_iov->iov_len -= left;
+    }
+    return byte_write;
+}
+
+const char *netSendModeName(sendModeT mode) {
+    switch (mode) {
+        case SEND_SENDFILE:
+            return "sendfile";
+        case SEND_SPLICE:
+            return "splice";
+        default:
+            return "read/write";
+    }
+}
+
+// sends up to count bytes of fd starting at *offset, advancing it;
+// may send less, returns -1 with errno EAGAIN when the socket buffer is full
+ssize_t netSendFile(sendModeT mode, int sock, int fd, int pipefd[2], off_t *piped, off_t *offset, size_t count) {
+    ssize_t rc;
+    switch (mode) {
+        case SEND_SENDFILE:
+            send_calls++;
+            rc = sendfile(sock, fd, offset, count);
+            if (rc < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                // file system without sendfile support
+                return send_copy(sock, fd, offset, count);
+            }
+            return rc;
+        case SEND_SPLICE:
+            rc = send_splice(sock, fd, pipefd, piped, offset, count);
+            if (rc < 0 && (errno == EINVAL || errno == ENOSYS) && *piped == 0) {
+                return send_copy(sock, fd, offset, count);
+            }
+            return rc;
+        default:
+            return send_copy(sock, fd, offset, count);
+    }
+}
+
+unsigned long long netSendCalls() {
+    return send_calls;
+}
+
+ssize_t send_copy(int sock, int fd, off_t *offset, size_t count) {
+    if (count > RESP_SIZE) {
+        count = RESP_SIZE;
+    }
+
+    ssize_t byte_read = pread(fd, copy_buf, count, *offset);
+    if (byte_read <= 0) {
+        return byte_read;
+    }
+
+    // bytes not taken by the socket are simply read again on the next call
+    send_calls++;
+    ssize_t byte_write = write(sock, copy_buf, byte_read);
+    if (byte_write > 0) {
+        *offset += byte_write;
+    }
+    return byte_write;
+}
+
+// file -> pipe -> socket; what the socket does not take stays in the pipe until the next call,
+// so the pipe belongs to the connection; *offset only advances by what reached the socket, the pipe holds
+// the *piped bytes after it, so both stay consistent whichever splice fails
+ssize_t send_splice(int sock, int fd, int pipefd[2], off_t *piped, off_t *offset, size_t count) {
+    if (pipefd[0] < 0 && pipe2(pipefd, O_CLOEXEC) < 0) {
+        logError(ERR_FSTR, "pipe2 failed", strerror(errno));
+        pipefd[0] = pipefd[1] = -1;
+        return -1;
+    }
+
+    if (*piped == 0) {
+        off_t in_offset = *offset;
+        ssize_t in_pipe = splice(fd, &in_offset, pipefd[1], NULL, count, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (in_pipe <= 0) {
+            return in_pipe;
+        }
+        *piped = in_pipe;
+    }
+
+    send_calls++;
+    ssize_t sent = splice(pipefd[0], NULL, sock, NULL, *piped, SPLICE_F_MOVE | SPLICE_F_MORE | SPLICE_F_NONBLOCK);
+    if (sent > 0) {
+        *piped -= sent;
+        *offset += sent;
+    }
+    return sent;
+}
@@ -1,21 +1,50 @@
 #pragma once
 
+#define _GNU_SOURCE
+
 #include <stdlib.h>
+#include <stdbool.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <threads.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
 #include <errno.h>
 #include <string.h>
 
 #include "../log/log.h"
 
 #define REQ_SIZE 2048
-#define RESP_SIZE 1024
+#define RESP_SIZE 65536
+
+typedef enum sendMode {
+    SEND_SENDFILE, SEND_SPLICE, SEND_COPY
+} sendModeT;
 
-int netListen(char *host, int port);
+// deferAcceptSec > 0 holds a connection back until its first data arrives (TCP_DEFER_ACCEPT), fastOpenQueue > 0
+// lets returning clients carry their request in the SYN (TCP_FASTOPEN); both are best effort
+int netListen(char *host, int port, bool reusePort, int deferAcceptSec, int fastOpenQueue, int sendBuffer);
 
+// the socket is non-blocking and close-on-exec from the start, -1 with EAGAIN once the backlog is empty
 int netAccept(int listen_sock);
 
+int netSetNonBlock(int fd);
+
 ssize_t netWrite(int fd, const void *buf, size_t n);
 
 ssize_t netRead(int fd, void *buf, size_t n);
+
+ssize_t netSendMsg(int fd, struct msghdr *msg, int flags);
+
+// splice goes through pipefd (created on first use), *piped counts the bytes left in it for the next call
+ssize_t netSendFile(sendModeT mode, int sock, int fd, int pipefd[2], off_t *piped, off_t *offset, size_t count);
+
+const char *netSendModeName(sendModeT mode);
+
+// send system calls made by the calling thread so far
+unsigned long long netSendCalls();
@@ -0,0 +1,150 @@
+#include "ring.h"
+#include "../log/log.h"
+
+#include <limits.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+ringT *ringNew(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    ringT *ring = aligned_alloc(CACHE_LINE, sizeof(ringT));
+    if (ring == NULL) {
+        logFatal(ERR_FSTR, "ring alloc failed", strerror(errno));
+        return NULL;
+    }
+    memset(ring, 0, sizeof(ringT));
+
+    ring->cells = aligned_alloc(CACHE_LINE, size * sizeof(ringCellT));
+    if (ring->cells == NULL) {
+        logFatal(ERR_FSTR, "ring cells alloc failed", strerror(errno));
+        free(ring);
+        return NULL;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        atomic_init(&ring->cells[i].seq, i);
+    }
+    ring->mask = size - 1;
+    // spinning only helps when a producer can run meanwhile
+    ring->spin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? RING_SPIN : 0;
+
+    return ring;
+}
+
+void ringFree(ringT *ring) {
+    free(ring->cells);
+    free(ring);
+}
+
+// returns -1 when the ring is full
+int ringPush(ringT *ring, const taskT *task) {
+    size_t pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    ringCellT *cell;
+    while (true) {
+        cell = &ring->cells[pos & ring->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->tail, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        }
+    }
+
+    cell->task = *task;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+
+    // pairs with the fence in ringPopWait: either we see the waiter or it sees the task
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->nWaiting, memory_order_relaxed) > 0) {
+        atomic_fetch_add(&ring->wakeSeq, 1);
+        futexWake(&ring->wakeSeq, 1);
+    }
+    return 0;
+}
+
+// returns -1 when the ring is empty
+int ringPop(ringT *ring, taskT *task) {
+    size_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    ringCellT *cell;
+    while (true) {
+        cell = &ring->cells[pos & ring->mask];
+        size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+
+    *task = cell->task;
+    atomic_store_explicit(&cell->seq, pos + ring->mask + 1, memory_order_release);
+    return 0;
+}
+
+// blocks until a task is taken (0) or stop is set (-1)
+int ringPopWait(ringT *ring, taskT *task, atomic_bool *stop) {
+    while (!atomic_load(stop)) {
+        for (int i = 0; i < ring->spin; ++i) {
+            if (ringPop(ring, task) == 0) {
+                return 0;
+            }
+            cpuRelax();
+        }
+
+        // announce the wait first, then re-check: a producer either sees us or we see its task
+        unsigned seq = atomic_load(&ring->wakeSeq);
+        atomic_fetch_add(&ring->nWaiting, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (ringPop(ring, task) == 0) {
+            atomic_fetch_sub(&ring->nWaiting, 1);
+            return 0;
+        }
+        if (!atomic_load(stop)) {
+            futexWait(&ring->wakeSeq, seq);
+        }
+        atomic_fetch_sub(&ring->nWaiting, 1);
+    }
+    return -1;
+}
+
+void ringWakeAll(ringT *ring) {
+    atomic_fetch_add(&ring->wakeSeq, 1);
+    futexWake(&ring->wakeSeq, INT_MAX);
+}
+
+size_t ringLen(ringT *ring) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+}
+
+void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+void futexWait(atomic_uint *addr, unsigned val) {
+    syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+}
+
+void futexWake(atomic_uint *addr, int n) {
+    syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "task.h"
+
+#define CACHE_LINE 64
+// pops tried before a consumer goes to sleep
+#define RING_SPIN 128
+
+typedef struct ringCell {
+    atomic_size_t seq;
+    taskT task;
+} ringCellT;
+
+// bounded lock-free MPMC ring (Vyukov), tasks are stored by value
+typedef struct ring {
+    _Alignas(CACHE_LINE) atomic_size_t head;
+    _Alignas(CACHE_LINE) atomic_size_t tail;
+
+    // eventcount: idle consumers sleep on wakeSeq with futex
+    _Alignas(CACHE_LINE) atomic_uint wakeSeq;
+    atomic_int nWaiting;
+
+    _Alignas(CACHE_LINE) ringCellT *cells;
+    size_t mask;
+    int spin;
+} ringT;
+
+ringT *ringNew(size_t capacity);
+
+void ringFree(ringT *ring);
+
+int ringPush(ringT *ring, const taskT *task);
+
+int ringPop(ringT *ring, taskT *task);
+
+int ringPopWait(ringT *ring, taskT *task, atomic_bool *stop);
+
+void ringWakeAll(ringT *ring);
+
+size_t ringLen(ringT *ring);
+
+void cpuRelax();
+
+void futexWait(atomic_uint *addr, unsigned val);
+
+void futexWake(atomic_uint *addr, int n);
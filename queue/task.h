@@ -1,12 +1,8 @@
 #pragma once
 
-#include <poll.h>
-
-typedef void (*handlerT)(int, char *);
+typedef void (*handlerT)(void *);
 
 typedef struct task {
     handlerT handler;
-
-    int conn;
-    char* wd;
+    void *arg;
 } taskT;
@@ -0,0 +1,39 @@
+#include "admission.h"
+
+#include <limits.h>
+
+#include "../log/log.h"
+
+void admissionInit(admissionT *adm, long long targetNs) {
+    adm->targetNs = targetNs;
+    atomic_init(&adm->minWaitNs, LLONG_MAX);
+    adm->intervalEnd = 0;
+    adm->overloaded = false;
+}
+
+void admissionRecord(admissionT *adm, long long waitNs) {
+    long long min = atomic_load_explicit(&adm->minWaitNs, memory_order_relaxed);
+    while (waitNs < min &&
+           !atomic_compare_exchange_weak_explicit(&adm->minWaitNs, &min, waitNs, memory_order_relaxed,
+                                                  memory_order_relaxed));
+}
+
+bool admissionOverloaded(admissionT *adm, long long nowNs) {
+    if (adm->targetNs <= 0) {
+        return false;
+    }
+    if (nowNs < adm->intervalEnd) {
+        return adm->overloaded;
+    }
+
+    long long min = atomic_exchange_explicit(&adm->minWaitNs, LLONG_MAX, memory_order_relaxed);
+    bool overloaded = min != LLONG_MAX && min > adm->targetNs;
+    if (overloaded && !adm->overloaded) {
+        logWarn("overloaded: pool queue wait above %lld ms, shedding new requests", adm->targetNs / 1000000);
+    } else if (!overloaded && adm->overloaded) {
+        logInfo("pool queue wait is back under %lld ms, admitting requests", adm->targetNs / 1000000);
+    }
+    adm->overloaded = overloaded;
+    adm->intervalEnd = nowNs + ADMISSION_INTERVAL_NS;
+    return overloaded;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+// queue waits are judged over windows of this length
+#define ADMISSION_INTERVAL_NS 100000000LL
+
+// CoDel-style overload detector of the pool queue: a burst drains within an interval, a standing queue keeps
+// even the shortest wait of the interval above the target
+typedef struct admission {
+    long long targetNs;
+    // shortest wait reported by the workers in the current interval
+    atomic_llong minWaitNs;
+    // the rest belongs to the event loop
+    long long intervalEnd;
+    bool overloaded;
+} admissionT;
+
+// a target of 0 admits everything
+void admissionInit(admissionT *adm, long long targetNs);
+
+// a worker took a connection that waited waitNs in the queue
+void admissionRecord(admissionT *adm, long long waitNs);
+
+// whether the event loop should shed new requests instead of queueing them, decided once per interval;
+// an interval nothing left the queue in is not overloaded, stuck workers fill the queue up and it sheds instead
+bool admissionOverloaded(admissionT *adm, long long nowNs);
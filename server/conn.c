@@ -0,0 +1,55 @@
+#include "conn.h"
+
+#include "server.h"
+
+connT *connNew(int fd, struct httpServer *server, slabT *slab) {
+    connT *conn = slabAlloc(slab);
+    if (conn == NULL) {
+        return NULL;
+    }
+
+    conn->fd = fd;
+    conn->server = server;
+    atomic_fetch_add_explicit(&server->nConns, 1, memory_order_relaxed);
+    conn->slab = slab;
+    conn->state = CONN_IDLE;
+    conn->pipe[0] = -1;
+    conn->pipe[1] = -1;
+    conn->timer.data = conn;
+    parserInit(&conn->parser);
+    return conn;
+}
+
+void connFree(connT *conn) {
+    if (conn->fd >= 0) {
+        close(conn->fd);
+    }
+    if (conn->pipe[0] >= 0) {
+        close(conn->pipe[0]);
+        close(conn->pipe[1]);
+    }
+    free(conn->spill);
+    atomic_fetch_sub_explicit(&conn->server->nConns, 1, memory_order_relaxed);
+    slabRelease(conn->slab, conn);
+}
+
+long long connDeadline(connT *conn, long long now) {
+    httpServerT *server = conn->server;
+    long long timeout;
+    if (conn->sending) {
+        conn->timeout = TIMEOUT_SEND;
+        timeout = server->sendTimeoutMs;
+    } else if (conn->len == 0 && conn->nRequests > 0) {
+        conn->timeout = TIMEOUT_IDLE;
+        timeout = server->keepAliveTimeoutMs;
+    } else {
+        // a new connection or a partial request: trickling bytes does not move the deadline
+        if (conn->headerSince == 0) {
+            conn->headerSince = now;
+        }
+        conn->timeout = TIMEOUT_HEADER;
+        timeout = server->headerTimeoutMs;
+        now = conn->headerSince;
+    }
+    return timeout > 0 ? now + timeout : -1;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "../mem/slab.h"
+#include "../net/net.h"
+#include "../event/wheel.h"
+#include "request.h"
+#include "metrics.h"
+#include "response.h"
+
+struct httpServer;
+struct reactor;
+struct proactor;
+
+typedef enum connState {
+    CONN_IDLE,      // parked in the event loop, waiting for the next request
+    CONN_BUSY,      // owned by a worker
+    CONN_WRITING,   // parked in the event loop until the socket takes the rest of conn->resp
+    CONN_CLOSE      // worker is done, event loop must close it
+} connStateT;
+
+typedef struct conn connT;
+
+struct conn {
+    int fd;
+    connStateT state;
+    struct httpServer *server;
+    // the event loop's slab it came from
+    slabT *slab;
+    struct reactor *reactor;
+
+    char buff[REQ_SIZE];
+    size_t len;
+    httpParserT parser;
+    requestT req;
+
+    int nRequests;
+    bool keepAlive;
+    // handed to the thread pool at, 0 when served in place
+    long long queuedAt;
+    // the response in flight (uring) or waiting for the socket to take the rest of it (pool and reuseport)
+    responseT resp;
+
+    // deadline in the event loop's timer wheel while the connection is parked there, and what it guards
+    timerT timer;
+    timeoutKindT timeout;
+    // first bytes of the request being received seen at, 0 until then
+    long long headerSince;
+
+    // event loop return list
+    connT *retNext;
+
+    // io_uring proactor: operations in flight and the progress of the response being sent
+    struct proactor *proactor;
+    int inflight;
+    bool recvArmed;
+    bool sending;
+    bool closing;
+    int pipe[2];
+    // body part being sent (multipart bodies have several) and the file range spliced (sent) after it;
+    // sending, part, segOffset/segLen, iov and msg also carry a parked response of a worker
+    int part;
+    char partHead[PART_HEAD_LEN];
+    off_t segOffset, segLen;
+    off_t taken, piped, sent;
+    struct iovec iov[2];
+    struct msghdr msg;
+    // pipelined bytes received while the request buffer is full
+    char *spill;
+    size_t spillLen, spillCap;
+};
+
+connT *connNew(int fd, struct httpServer *server, slabT *slab);
+
+void connFree(connT *conn);
+
+// when a connection parked in its event loop is closed: the header block has to be complete headerTimeout after
+// it started, a keep-alive connection may wait keepAliveTimeout for the next request and a response being sent
+// has to make progress every sendTimeout; -1 when it may wait forever
+long long connDeadline(connT *conn, long long now);
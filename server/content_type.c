@@ -1,5 +1,34 @@
 #include "content_type.h"
 
+#include <string.h>
+
 char *TYPE_EXT[TYPE_NUM] = {"txt", "css", "html", "js", "png", "jpg", "jpeg", "swf", "gif"};
 char *MIME_TYPE[TYPE_NUM] = {"text/plain", "text/css", "text/html", "text/javascript", "image/png", "image/jpeg",
                              "image/jpeg", "application/x-shockwave-flash", "image/gif"};
+
+char *get_type(char *path) {
+    char *res = path + strlen(path) - 1;
+    while (res >= path && *res != '.' && *res != '/') {
+        res--;
+    }
+
+    if (res < path || *res == '/') {
+        return NULL;
+    }
+    return ++res;
+}
+
+char *get_content_type(char *path) {
+    char *ext = get_type(path);
+    if (ext == NULL) {
+        return NULL;
+    }
+
+    int i = 0;
+    for (; i < TYPE_NUM && strcmp(TYPE_EXT[i], ext) != 0; i++);
+    if (i >= TYPE_NUM) {
+        return NULL;
+    }
+
+    return MIME_TYPE[i];
+}
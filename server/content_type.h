@@ -4,3 +4,9 @@
 
 extern char *TYPE_EXT[TYPE_NUM];
 extern char *MIME_TYPE[TYPE_NUM];
+
+// extension of the last path component, NULL without one
+char *get_type(char *path);
+
+// mime type by extension, NULL for unknown ones
+char *get_content_type(char *path);
@@ -0,0 +1,83 @@
+#include "encoding.h"
+
+int coding_of(sliceT name);
+
+bool zero_quality(sliceT params);
+
+sliceT trim_space(const char *ptr, const char *end);
+
+unsigned acceptedEncodings(const sliceT *value) {
+    if (value == NULL) {
+        return 0;
+    }
+
+    unsigned listed = 0, accepted = 0;
+    bool wildcard = false;
+    const char *ptr = value->ptr;
+    const char *end = value->ptr + value->len;
+    while (ptr < end) {
+        const char *element_end = memchr(ptr, ',', end - ptr);
+        if (element_end == NULL) {
+            element_end = end;
+        }
+        const char *params = memchr(ptr, ';', element_end - ptr);
+        sliceT name = trim_space(ptr, params != NULL ? params : element_end);
+        bool refused = params != NULL && zero_quality(trim_space(params + 1, element_end));
+
+        if (name.len == 1 && name.ptr[0] == '*') {
+            wildcard = !refused;
+        } else {
+            int coding = coding_of(name);
+            if (coding >= 0) {
+                listed |= ENC_BIT(coding);
+                accepted |= refused ? 0 : ENC_BIT(coding);
+            }
+        }
+        ptr = element_end + 1;
+    }
+
+    // "*" stands for every coding not named explicitly
+    if (wildcard) {
+        accepted |= (ENC_BIT(ENC_COUNT) - 1) & ~listed;
+    }
+    return accepted;
+}
+
+int coding_of(sliceT name) {
+    if (sliceEqualsCase(name, "br")) {
+        return ENC_BR;
+    }
+    if (sliceEqualsCase(name, "gzip") || sliceEqualsCase(name, "x-gzip")) {
+        return ENC_GZIP;
+    }
+    return -1;
+}
+
+// "q=0", "q=0.0" ... refuse a coding, any other weight accepts it
+bool zero_quality(sliceT params) {
+    if (params.len < 2 || (params.ptr[0] != 'q' && params.ptr[0] != 'Q') || params.ptr[1] != '=') {
+        return false;
+    }
+    const char *ptr = params.ptr + 2;
+    const char *end = params.ptr + params.len;
+    if (ptr == end || *ptr++ != '0') {
+        return false;
+    }
+    if (ptr < end && *ptr == '.') {
+        ptr++;
+    }
+    while (ptr < end && *ptr == '0') {
+        ptr++;
+    }
+    return ptr == end;
+}
+
+sliceT trim_space(const char *ptr, const char *end) {
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t')) {
+        ptr++;
+    }
+    while (end > ptr && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    return (sliceT) {.ptr = ptr, .len = end - ptr};
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include "request.h"
+#include "../cache/variant_cache.h"
+
+// content codings of an Accept-Encoding value the server can send, as ENC_BIT flags
+unsigned acceptedEncodings(const sliceT *value);
@@ -0,0 +1,1018 @@
+#include "handler.h"
+#include "request.h"
+#include "responses.h"
+#include "content_type.h"
+#include "encoding.h"
+#include "metrics.h"
+#include "../fs/root.h"
+#include "../event/clock.h"
+#include "../mem/alloc_stats.h"
+
+#define PATH_MAX 256
+#define CACHE_REVALIDATE_MS 1000
+// pipelined responses gathered into one write
+#define PIPELINE_DEPTH 16
+// file bodies read into the batch to go out in the same write as their headers, at most this much per batch
+#define INLINE_BODY_LEN 32768
+#define BOUNDARY_LEN 21
+
+connStateT serve_conn(connT *conn);
+
+int read_req(connT *conn);
+
+connStateT serve_pipeline(connT *conn);
+
+int flush_batch(connT *conn, responseT *batch, int n_resp, struct iovec *iov, int n_iov);
+
+size_t rewind_batch(connT *conn, responseT *batch, const size_t *starts, int parked, int n_resp, size_t consumed);
+
+void complete_response(responseT *resp, bool sent);
+
+void start_pending(connT *conn, responseT *resp, size_t done);
+
+int send_pending(connT *conn);
+
+fileEntryT *open_file(connT *conn, const char *url, responseT *resp);
+
+bool lookup_cached(connT *conn, requestT *req, responseT *resp);
+
+cacheEntryT *load_entry(fileEntryT *file);
+
+void set_cached(connT *conn, responseT *resp, cacheEntryT *entry, request_method_t type);
+
+void set_file(connT *conn, responseT *resp, fileEntryT *file, request_method_t type);
+
+bool set_variant(connT *conn, responseT *resp, const char *key, const char *mime, const validatorT *validator,
+                 request_method_t type);
+
+void set_metrics(connT *conn, responseT *resp, request_method_t type);
+
+void set_error(connT *conn, responseT *resp, const char *status);
+
+bool not_modified(connT *conn, responseT *resp, const validatorT *validator);
+
+bool etag_listed(sliceT list, const char *etag);
+
+void apply_ranges(connT *conn, responseT *resp, off_t size, const char *mime, const validatorT *validator);
+
+bool if_range_matches(const sliceT *value, const validatorT *validator);
+
+int render_multipart(responseT *resp, off_t size, const char *mime, const validatorT *validator);
+
+int render_part(responseT *resp, int part, char *buff);
+
+int append_connection(connT *conn, responseT *resp);
+
+bool inline_body(responseT *resp, char *buff, size_t size);
+
+bool has_body_pass(responseT *resp);
+
+size_t gathered_len(responseT *resp);
+
+int render_headers(char *buff, size_t size, const char *status, off_t content_len, const char *mime_type,
+                   const validatorT *validator, const char *encoding);
+
+const char *connection_header(connT *conn);
+
+// multipart boundaries only have to be unlikely inside the parts, a counter is enough
+atomic_ullong boundary_seq = 0;
+
+void handle_connection(void *arg) {
+    connT *conn = (connT *) arg;
+    unsigned long long allocs = allocCount();
+    unsigned long long send_calls = netSendCalls();
+    if (conn->queuedAt > 0) {
+        long long wait = clockNowNs() - conn->queuedAt;
+        metricsQueueWait(wait);
+        admissionRecord(&conn->server->admission, wait);
+        conn->queuedAt = 0;
+    }
+
+    logDebug("handle_connection started");
+    connStateT state = serve_conn(conn);
+    metricsSendCalls(netSendCalls() - send_calls);
+    metricsAllocations(allocCount() - allocs);
+
+    logDebug("handle_connection finished");
+    reactorReturnConn(conn, state);
+}
+
+// never waits for the socket: returns what the connection waits for next in its event loop
+connStateT serve_conn(connT *conn) {
+    if (conn->sending) {
+        int rc = send_pending(conn);
+        if (rc > 0) {
+            return CONN_WRITING;
+        }
+        conn->sending = false;
+        complete_response(&conn->resp, rc == 0);
+        if (rc < 0 || !conn->keepAlive) {
+            return CONN_CLOSE;
+        }
+        // requests pipelined behind it may be complete in the buffer already
+        return serve_pipeline(conn);
+    }
+
+    int rc = read_req(conn);
+    if (rc < 0) {
+        return CONN_CLOSE;
+    }
+    if (rc > 0) {
+        // the rest of the request has not arrived yet
+        return CONN_IDLE;
+    }
+    logDebug("read_req");
+    return serve_pipeline(conn);
+}
+
+// reads what the socket has: 0 once the buffer holds a complete header block (or a broken one),
+// 1 when the rest is still to come, -1 when the client is gone
+int read_req(connT *conn) {
+    logDebug("read_req in");
+
+    while (true) {
+        long byte_read = netRead(conn->fd, conn->buff + conn->len, REQ_SIZE - 1 - conn->len);
+        if (byte_read < 0 && errno == EAGAIN) {
+            return 1;
+        }
+        if (byte_read <= 0) {
+            // 0 is an orderly shutdown of a persistent connection
+            return -1;
+        }
+        conn->len += byte_read;
+
+        if (parserFeed(&conn->parser, &conn->req, conn->buff, conn->len) != PARSE_MORE) {
+            return 0;
+        }
+        if (conn->len >= REQ_SIZE - 1) {
+            conn->parser.status = PARSE_ERROR;
+            conn->parser.error = HEADERS_TOO_LARGE_STR;
+            return 0;
+        }
+    }
+}
+
+// answers every complete request in the buffer in order, gathering the responses into as few writes as possible;
+// a response the socket has no room for is parked in conn->resp, the requests behind it stay buffered
+connStateT serve_pipeline(connT *conn) {
+    responseT batch[PIPELINE_DEPTH];
+    struct iovec iov[2 * PIPELINE_DEPTH];
+    // where the request of each response starts in the buffer
+    size_t starts[PIPELINE_DEPTH];
+    char bodies[INLINE_BODY_LEN];
+    int n_resp = 0, n_iov = 0;
+    size_t consumed = 0, inlined = 0;
+
+    while (true) {
+        parseStatusT status = parserFeed(&conn->parser, &conn->req, conn->buff + consumed, conn->len - consumed);
+        if (status == PARSE_MORE) {
+            break;
+        }
+
+        starts[n_resp] = consumed;
+        responseT *resp = &batch[n_resp++];
+        prepare_response(conn, resp);
+        // nothing after a malformed request can be trusted
+        consumed = status == PARSE_DONE ? consumed + conn->parser.length : conn->len;
+        parserInit(&conn->parser);
+
+        if (inline_body(resp, bodies + inlined, sizeof(bodies) - inlined)) {
+            inlined += resp->bodyLen;
+        }
+        iov[n_iov++] = (struct iovec) {.iov_base = resp->head, .iov_len = resp->headLen};
+        if (resp->body != NULL && resp->nRanges == 0 && resp->bodyLen > 0) {
+            const char *body = resp->inlined ? resp->body : resp->body + resp->offset;
+            iov[n_iov++] = (struct iovec) {.iov_base = (char *) body, .iov_len = resp->bodyLen};
+        }
+
+        // file and multipart bodies are sent on their own, so the batch in front of them goes first
+        if (has_body_pass(resp) || !conn->keepAlive || n_resp == PIPELINE_DEPTH) {
+            int done = flush_batch(conn, batch, n_resp, iov, n_iov);
+            if (done < n_resp) {
+                consumed = rewind_batch(conn, batch, starts, done, n_resp, consumed);
+            }
+            n_resp = n_iov = 0;
+            inlined = 0;
+        }
+        if (!conn->keepAlive || conn->sending) {
+            break;
+        }
+    }
+    if (n_resp > 0) {
+        int done = flush_batch(conn, batch, n_resp, iov, n_iov);
+        if (done < n_resp) {
+            consumed = rewind_batch(conn, batch, starts, done, n_resp, consumed);
+        }
+    }
+
+    // a partial request is parsed again from its start once the rest arrives
+    conn->len -= consumed;
+    memmove(conn->buff, conn->buff + consumed, conn->len);
+    parserInit(&conn->parser);
+
+    if (conn->sending) {
+        return CONN_WRITING;
+    }
+    return conn->keepAlive ? CONN_IDLE : CONN_CLOSE;
+}
+
+// writes prepared responses in order, only the last one may need a separate body pass; returns the index of
+// the response the socket had no room for, now parked in conn->resp, or n_resp once all of them are done
+int flush_batch(connT *conn, responseT *batch, int n_resp, struct iovec *iov, int n_iov) {
+    bool body_pass = has_body_pass(&batch[n_resp - 1]);
+
+    // MSG_MORE lets the headers share a segment with the start of the body
+    struct msghdr msg = {.msg_iov = iov, .msg_iovlen = n_iov};
+    size_t written = 0;
+    bool failed = false;
+    while (msg.msg_iovlen > 0) {
+        ssize_t byte_write = netSendMsg(conn->fd, &msg, body_pass ? MSG_MORE : 0);
+        if (byte_write < 0) {
+            failed = errno != EAGAIN;
+            break;
+        }
+        written += byte_write;
+    }
+
+    for (int i = 0; i < n_resp; ++i) {
+        responseT *resp = &batch[i];
+        logDebug("headers: %.*s", (int) resp->headLen, resp->head);
+        size_t len = gathered_len(resp);
+        if (failed) {
+            conn->keepAlive = false;
+            complete_response(resp, false);
+            continue;
+        }
+        if (written >= len && !has_body_pass(resp)) {
+            written -= len;
+            complete_response(resp, true);
+            continue;
+        }
+
+        // the rest of it goes through the resumable send
+        start_pending(conn, resp, written);
+        written = 0;
+        int rc = send_pending(conn);
+        if (rc > 0) {
+            return i;
+        }
+        conn->sending = false;
+        complete_response(&conn->resp, rc == 0);
+        if (rc < 0) {
+            conn->keepAlive = false;
+            failed = true;
+        }
+    }
+    return n_resp;
+}
+
+// the requests answered after a parked response are parsed and answered again once it is sent
+size_t rewind_batch(connT *conn, responseT *batch, const size_t *starts, int parked, int n_resp, size_t consumed) {
+    if (parked + 1 == n_resp) {
+        return consumed;
+    }
+    for (int i = parked + 1; i < n_resp; ++i) {
+        if (batch[i].method != BAD) {
+            conn->nRequests--;
+        }
+        release_response(&batch[i]);
+    }
+    // only the last response of a batch may close the connection
+    conn->keepAlive = true;
+    return starts[parked + 1];
+}
+
+// counts a response once it is written or given up on and drops its body references
+void complete_response(responseT *resp, bool sent) {
+    if (sent && (resp->status == 200 || resp->status == 206)) {
+        logInfo("successful response");
+    }
+    metricsResponse(resp->method, resp->status, sent ? resp->headLen + resp->bodyLen : 0,
+                    clockNowNs() - resp->startNs);
+    release_response(resp);
+}
+
+// moves resp to conn->resp, done bytes of its header block and memory body are written already
+void start_pending(connT *conn, responseT *resp, size_t done) {
+    conn->resp = *resp;
+    resp = &conn->resp;
+    if (resp->inlined) {
+        // the batch buffer is gone once the worker returns, the file still holds the body
+        resp->body = NULL;
+        resp->inlined = false;
+    }
+    conn->sending = true;
+    conn->part = 0;
+    conn->piped = 0;
+
+    // a multipart body follows part by part once the header block is out
+    bool single = resp->nRanges == 0;
+    conn->segOffset = resp->offset;
+    conn->segLen = single && resp->file != NULL && resp->body == NULL ? resp->bodyLen : 0;
+
+    conn->iov[0].iov_base = resp->head;
+    conn->iov[0].iov_len = resp->headLen;
+    conn->iov[1].iov_base = single && resp->body != NULL ? (char *) resp->body + resp->offset : NULL;
+    conn->iov[1].iov_len = single && resp->body != NULL ? resp->bodyLen : 0;
+    memset(&conn->msg, 0, sizeof(conn->msg));
+    conn->msg.msg_iov = conn->iov;
+    conn->msg.msg_iovlen = conn->iov[1].iov_len > 0 ? 2 : 1;
+
+    while (conn->msg.msg_iovlen > 0 && done >= conn->msg.msg_iov->iov_len) {
+        done -= conn->msg.msg_iov->iov_len;
+        conn->msg.msg_iov++;
+        conn->msg.msg_iovlen--;
+    }
+    if (conn->msg.msg_iovlen > 0) {
+        conn->msg.msg_iov->iov_base = (char *) conn->msg.msg_iov->iov_base + done;
+        conn->msg.msg_iov->iov_len -= done;
+    } else {
+        // part of an inlined body went out from the batch buffer
+        conn->segOffset += (off_t) done;
+        conn->segLen -= (off_t) done;
+    }
+}
+
+// continues conn->resp where the socket filled up: 0 once it is sent, 1 when the socket is full again, -1 on errors
+int send_pending(connT *conn) {
+    responseT *resp = &conn->resp;
+    while (true) {
+        if (conn->msg.msg_iovlen > 0) {
+            bool more = conn->segLen > 0 || (resp->nRanges > 0 && conn->part <= resp->nRanges);
+            if (netSendMsg(conn->fd, &conn->msg, more ? MSG_MORE : 0) < 0) {
+                return errno == EAGAIN ? 1 : -1;
+            }
+            continue;
+        }
+
+        if (conn->segLen > 0) {
+            // the fd may be shared with other workers, only offset based transfers are allowed
+            off_t offset = conn->segOffset;
+            ssize_t byte_write = netSendFile(conn->server->sendMode, conn->fd, resp->file->fd, conn->pipe,
+                                             &conn->piped, &offset, conn->segLen);
+            if (byte_write < 0 && errno == EINTR) {
+                continue;
+            }
+            if (byte_write < 0 && errno == EAGAIN) {
+                return 1;
+            }
+            if (byte_write <= 0) {
+                // error or the file was truncated under us
+                logError(ERR_FSTR, "send file error", byte_write < 0 ? strerror(errno) : "unexpected EOF");
+                return -1;
+            }
+            conn->segOffset = offset;
+            conn->segLen -= byte_write;
+            continue;
+        }
+
+        if (resp->nRanges == 0 || conn->part > resp->nRanges) {
+            return 0;
+        }
+
+        // next part header of a multipart body, with its range when it is in memory
+        int part = conn->part++;
+        conn->iov[0] = response_part(resp, part, conn->partHead);
+        conn->msg.msg_iov = conn->iov;
+        conn->msg.msg_iovlen = 1;
+        if (part < resp->nRanges) {
+            byteRangeT *range = &resp->ranges[part];
+            if (resp->body != NULL) {
+                conn->iov[1].iov_base = (char *) resp->body + range->offset;
+                conn->iov[1].iov_len = range->len;
+                conn->msg.msg_iovlen = 2;
+            } else {
+                conn->segOffset = range->offset;
+                conn->segLen = range->len;
+            }
+        }
+    }
+}
+
+void prepare_response(connT *conn, responseT *resp) {
+    httpServerT *server = conn->server;
+    requestT *req = &conn->req;
+
+    resp->startNs = clockNowNs();
+    // the header deadline of the next request starts with its first bytes
+    conn->headerSince = 0;
+    resp->method = conn->parser.status == PARSE_DONE ? req->method : BAD;
+    resp->headLen = 0;
+    resp->entry = NULL;
+    resp->variant = NULL;
+    resp->generated = NULL;
+    resp->body = NULL;
+    resp->file = NULL;
+    resp->offset = 0;
+    resp->bodyLen = 0;
+    resp->nRanges = 0;
+    resp->inlined = false;
+    conn->keepAlive = false;
+
+    if (conn->parser.status != PARSE_DONE) {
+        set_error(conn, resp, conn->parser.error != NULL ? conn->parser.error : BAD_REQUEST_STR);
+        return;
+    }
+
+    if (req->method == BAD) {
+        // the body of an unsupported method would be taken for the next request
+        logError("unsupported http method");
+        set_error(conn, resp, M_NOT_ALLOWED_STR);
+        return;
+    }
+
+    conn->nRequests++;
+    conn->keepAlive = req->keepAlive && server->keepAliveTimeoutMs > 0 &&
+                      (server->keepAliveMax <= 0 || conn->nRequests < server->keepAliveMax);
+
+    if (server->metricsPath != NULL && strcmp(req->url, server->metricsPath) == 0) {
+        set_metrics(conn, resp, req->method);
+        return;
+    }
+
+    if (server->cache != NULL && lookup_cached(conn, req, resp)) {
+        return;
+    }
+
+    fileEntryT *file = open_file(conn, req->url, resp);
+    if (file == NULL) {
+        return;
+    }
+
+    contentCacheT *cache = server->cache;
+    if (cache != NULL && contentCacheAdmit(cache, file->key, file->size)) {
+        cacheEntryT *entry = load_entry(file);
+        if (entry != NULL) {
+            // without inotify there is nothing to invalidate the entry but the revalidation in lookup_cached
+            contentCachePut(cache, entry, server->files != NULL ? &file->removed : NULL);
+            fileEntryRelease(file);
+            set_cached(conn, resp, entry, req->method);
+            return;
+        }
+    }
+
+    set_file(conn, resp, file, req->method);
+}
+
+void release_response(responseT *resp) {
+    if (resp->entry != NULL) {
+        contentCacheRelease(resp->entry);
+        resp->entry = NULL;
+    }
+    if (resp->variant != NULL) {
+        variantRelease(resp->variant);
+        resp->variant = NULL;
+    }
+    free(resp->generated);
+    resp->generated = NULL;
+    resp->body = NULL;
+    resp->inlined = false;
+    if (resp->file != NULL) {
+        fileEntryRelease(resp->file);
+        resp->file = NULL;
+    }
+    resp->nRanges = 0;
+}
+
+struct iovec response_part(responseT *resp, int part, char *buff) {
+    int rc = render_part(resp, part, buff);
+    return (struct iovec) {.iov_base = buff, .iov_len = rc > 0 ? (size_t) rc : 0};
+}
+
+// resolves url to an open file, from the file cache when possible; sets the error response itself
+fileEntryT *open_file(connT *conn, const char *url, responseT *resp) {
+    fileCacheT *files = conn->server->files;
+    if (files != NULL) {
+        fileEntryT *file = fileCacheGet(files, url);
+        if (file != NULL && not_modified(conn, resp, &file->validator)) {
+            fileEntryRelease(file);
+            return NULL;
+        }
+        if (file != NULL) {
+            return file;
+        }
+    }
+    unsigned generation = files != NULL ? fileCacheGeneration(files) : 0;
+
+    // one lookup that cannot leave the root, whatever the url holds
+    int fd = rootOpen(conn->server->rootFd, url, O_RDONLY);
+    if (fd < 0) {
+        if (errno == EXDEV || errno == ELOOP || errno == EACCES) {
+            set_error(conn, resp, FORBIDDEN_STR);
+            logError("attempt to access outside the root: %s", url);
+        } else if (errno == ENOENT || errno == ENOTDIR || errno == ENAMETOOLONG) {
+            set_error(conn, resp, NOT_FOUND_STR);
+            logError(ERR_FSTR, "open error", strerror(errno));
+        } else {
+            set_error(conn, resp, INT_SERVER_ERR_STR);
+            logError(ERR_FSTR, "open error", strerror(errno));
+        }
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        logError("open error: not a regular file");
+        set_error(conn, resp, NOT_FOUND_STR);
+        close(fd);
+        return NULL;
+    }
+
+    // the resolved path keys inotify invalidation
+    char path[PATH_MAX];
+    if (rootFdPath(fd, path, sizeof(path)) < 0) {
+        logError(ERR_FSTR, "failed resolve fd path", strerror(errno));
+        set_error(conn, resp, INT_SERVER_ERR_STR);
+        close(fd);
+        return NULL;
+    }
+    logDebug("path: %s", path);
+
+    fileEntryT *file = fileEntryNew(url, path, fd, &st, get_content_type(path));
+    if (file == NULL) {
+        close(fd);
+        set_error(conn, resp, INT_SERVER_ERR_STR);
+        return NULL;
+    }
+
+    if (files != NULL) {
+        fileCachePut(files, file, generation);
+    }
+    // the open is a single syscall now, the validators come from its fstat
+    if (not_modified(conn, resp, &file->validator)) {
+        fileEntryRelease(file);
+        return NULL;
+    }
+    return file;
+}
+
+void send_shed_response(int fd) {
+    if (send(fd, SHED_RESPONSE, sizeof(SHED_RESPONSE) - 1, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+        logDebug(ERR_FSTR, "shed response not sent", strerror(errno));
+    }
+}
+
+void drop_content(void *arg, const char *key) {
+    contentCacheT *cache = (contentCacheT *) arg;
+    if (key == NULL) {
+        contentCacheClear(cache);
+    } else {
+        contentCacheRemoveKey(cache, key);
+    }
+}
+
+// serves a hit straight from memory, skipping the open
+bool lookup_cached(connT *conn, requestT *req, responseT *resp) {
+    contentCacheT *cache = conn->server->cache;
+    cacheEntryT *entry = contentCacheGet(cache, req->url);
+    if (entry == NULL) {
+        return false;
+    }
+
+    // with the file cache running, inotify invalidates entries and no polling is needed
+    long long now = clockNowMs();
+    if (conn->server->files == NULL && now - atomic_load(&entry->checkedAt) >= CACHE_REVALIDATE_MS) {
+        struct stat st;
+        if (stat(req->url, &st) < 0 || st.st_ino != entry->ino || st.st_size != entry->size ||
+            st.st_mtim.tv_sec != entry->mtime.tv_sec || st.st_mtim.tv_nsec != entry->mtime.tv_nsec) {
+            logDebug("cached %s is stale", entry->key);
+            contentCacheRemove(cache, entry);
+            contentCacheRelease(entry);
+            return false;
+        }
+        atomic_store(&entry->checkedAt, now);
+    }
+
+    if (not_modified(conn, resp, &entry->validator)) {
+        contentCacheRelease(entry);
+        return true;
+    }
+    set_cached(conn, resp, entry, req->method);
+    return true;
+}
+
+cacheEntryT *load_entry(fileEntryT *file) {
+    char headers[HEADER_LEN];
+    int headers_len = render_headers(headers, sizeof(headers), OK_STR, file->size, file->mime, &file->validator, NULL);
+    if (headers_len < 0) {
+        return NULL;
+    }
+
+    cacheEntryT *entry = cacheEntryNew(file->key, headers_len, file->size);
+    if (entry == NULL) {
+        return NULL;
+    }
+    memcpy(entry->headers, headers, headers_len);
+
+    size_t total_read = 0;
+    while (total_read < entry->bodyLen) {
+        ssize_t byte_read = pread(file->fd, entry->body + total_read, entry->bodyLen - total_read, total_read);
+        if (byte_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (byte_read <= 0) {
+            logError(ERR_FSTR, "read error", byte_read < 0 ? strerror(errno) : "file truncated");
+            contentCacheRelease(entry);
+            return NULL;
+        }
+        total_read += byte_read;
+    }
+
+    entry->mime = file->mime;
+    entry->validator = file->validator;
+    entry->ino = file->ino;
+    entry->size = file->size;
+    entry->mtime = file->mtime;
+    atomic_store(&entry->checkedAt, clockNowMs());
+    return entry;
+}
+
+// takes over the entry reference
+void set_cached(connT *conn, responseT *resp, cacheEntryT *entry, request_method_t type) {
+    if (set_variant(conn, resp, entry->key, entry->mime, &entry->validator, type)) {
+        contentCacheRelease(entry);
+        return;
+    }
+    if (entry->headersLen >= sizeof(resp->head)) {
+        contentCacheRelease(entry);
+        set_error(conn, resp, INT_SERVER_ERR_STR);
+        return;
+    }
+    memcpy(resp->head, entry->headers, entry->headersLen);
+    resp->headLen = entry->headersLen;
+    if (append_connection(conn, resp) < 0) {
+        contentCacheRelease(entry);
+        set_error(conn, resp, INT_SERVER_ERR_STR);
+        return;
+    }
+
+    resp->status = 200;
+    if (type == GET) {
+        resp->entry = entry;
+        resp->body = entry->body;
+        resp->bodyLen = (off_t) entry->bodyLen;
+        apply_ranges(conn, resp, (off_t) entry->bodyLen, entry->mime, &entry->validator);
+    } else {
+        contentCacheRelease(entry);
+    }
+}
+
+// takes over the file reference
+void set_file(connT *conn, responseT *resp, fileEntryT *file, request_method_t type) {
+    if (set_variant(conn, resp, file->key, file->mime, &file->validator, type)) {
+        fileEntryRelease(file);
+        return;
+    }
+
+    int rc = render_headers(resp->head, sizeof(resp->head), OK_STR, file->size, file->mime, &file->validator, NULL);
+    if (rc < 0) {
+        fileEntryRelease(file);
+        set_error(conn, resp, INT_SERVER_ERR_STR);
+        return;
+    }
+    resp->headLen = rc;
+    if (append_connection(conn, resp) < 0) {
+        fileEntryRelease(file);
+        set_error(conn, resp, INT_SERVER_ERR_STR);
+        return;
+    }
+
+    resp->status = 200;
+    if (type == GET) {
+        resp->file = file;
+        resp->bodyLen = file->size;
+        apply_ranges(conn, resp, file->size, file->mime, &file->validator);
+    } else {
+        fileEntryRelease(file);
+    }
+}
+
+// a compressed variant the client accepts, ready in the variant cache; ranges always address the identity
+bool set_variant(connT *conn, responseT *resp, const char *key, const char *mime, const validatorT *validator,
+                 request_method_t type) {
+    variantCacheT *variants = conn->server->variants;
+    if (variants == NULL || requestHeader(&conn->req, "Range") != NULL) {
+        return false;
+    }
+    unsigned accepted = acceptedEncodings(requestHeader(&conn->req, "Accept-Encoding"));
+    if (accepted == 0) {
+        return false;
+    }
+    variantT *variant = variantCacheGet(variants, key, accepted, mime, validator);
+    if (variant == NULL) {
+        return false;
+    }
+
+    int rc = render_headers(resp->head, sizeof(resp->head), OK_STR, (off_t) variant->bodyLen, mime,
+                            &variant->validator, encodingName(variant->enc));
+    if (rc < 0) {
+        variantRelease(variant);
+        return false;
+    }
+    resp->headLen = rc;
+    if (append_connection(conn, resp) < 0) {
+        variantRelease(variant);
+        return false;
+    }
+
+    resp->status = 200;
+    if (type == GET) {
+        resp->bodyLen = (off_t) variant->bodyLen;
+        if (variant->file != NULL) {
+            fileEntryRetain(variant->file);
+            resp->file = variant->file;
+        } else {
+            resp->variant = variant;
+            resp->body = variant->body;
+            return true;
+        }
+    }
+    variantRelease(variant);
+    return true;
+}
+
+// counters of every thread and the server gauges in the Prometheus text format, rendered for this response
+void set_metrics(connT *conn, responseT *resp, request_method_t type) {
+    char *body = NULL;
+    size_t len = 0;
+    FILE *out = open_memstream(&body, &len);
+    if (out == NULL) {
+        logError(ERR_FSTR, "failed open metrics stream", strerror(errno));
+        set_error(conn, resp, INT_SERVER_ERR_STR);
+        return;
+    }
+    metricsWrite(out);
+    httpServerWriteMetrics(conn->server, out);
+    if (fclose(out) != 0) {
+        logError(ERR_FSTR, "failed render metrics", strerror(errno));
+        free(body);
+        set_error(conn, resp, INT_SERVER_ERR_STR);
+        return;
+    }
+
+    int rc = snprintf(resp->head, sizeof(resp->head), "%s\r\nContent-Length: %zu\r\nContent-Type: %s\r\n"
+                                                      "Cache-Control: no-store\r\n", OK_STR, len, METRICS_TYPE);
+    resp->headLen = rc > 0 && (size_t) rc < sizeof(resp->head) ? rc : 0;
+    if (resp->headLen == 0 || append_connection(conn, resp) < 0) {
+        free(body);
+        set_error(conn, resp, INT_SERVER_ERR_STR);
+        return;
+    }
+
+    resp->status = 200;
+    if (type == GET) {
+        resp->generated = body;
+        resp->body = body;
+        resp->bodyLen = (off_t) len;
+    } else {
+        free(body);
+    }
+}
+
+void set_error(connT *conn, responseT *resp, const char *status) {
+    logInfo("%s", status);
+
+    resp->status = atoi(status + sizeof(HTTP11_STR));
+    int rc = snprintf(resp->head, sizeof(resp->head), "%s\r\n%s\r\nContent-Length: 0\r\n\r\n", status,
+                      connection_header(conn));
+    resp->headLen = rc > 0 ? rc : 0;
+}
+
+// evaluates If-None-Match, or If-Modified-Since without it, and sets a header-only 304 on a match
+bool not_modified(connT *conn, responseT *resp, const validatorT *validator) {
+    const sliceT *none_match = requestHeader(&conn->req, "If-None-Match");
+    const sliceT *modified_since = none_match == NULL ? requestHeader(&conn->req, "If-Modified-Since") : NULL;
+    if (none_match == NULL && modified_since == NULL) {
+        return false;
+    }
+    httpServerT *server = conn->server;
+    atomic_fetch_add_explicit(&server->conditionals, 1, memory_order_relaxed);
+
+    bool match;
+    validatorT encoded;
+    if (none_match != NULL) {
+        match = etag_listed(*none_match, validator->etag);
+        // the client may hold one of the compressed representations of this version
+        unsigned accepted = server->variants != NULL ?
+                            acceptedEncodings(requestHeader(&conn->req, "Accept-Encoding")) : 0;
+        for (encodingT enc = 0; !match && enc < ENC_COUNT; ++enc) {
+            if (accepted & ENC_BIT(enc)) {
+                validatorVariant(&encoded, validator, encodingName(enc));
+                match = etag_listed(*none_match, encoded.etag);
+                validator = match ? &encoded : validator;
+            }
+        }
+    } else {
+        time_t since;
+        match = httpDateParse(modified_since->ptr, modified_since->len, &since) == 0 && validator->mtime <= since;
+    }
+    if (!match) {
+        return false;
+    }
+    atomic_fetch_add_explicit(&server->notModified, 1, memory_order_relaxed);
+
+    resp->status = 304;
+    int rc = snprintf(resp->head, sizeof(resp->head), "%s\r\nETag: %s\r\nLast-Modified: %s\r\n"
+                                                      "Vary: Accept-Encoding\r\n%s\r\n\r\n",
+                      NOT_MODIFIED_STR, validator->etag, validator->lastModified, connection_header(conn));
+    resp->headLen = rc > 0 ? rc : 0;
+    return true;
+}
+
+// weak comparison against a comma separated list of entity tags, "*" matches any
+bool etag_listed(sliceT list, const char *etag) {
+    size_t etag_len = strlen(etag);
+    const char *ptr = list.ptr;
+    const char *end = list.ptr + list.len;
+    while (ptr < end) {
+        while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == ',')) {
+            ptr++;
+        }
+        const char *tag = ptr;
+        while (ptr < end && *ptr != ',') {
+            ptr++;
+        }
+        const char *tag_end = ptr;
+        while (tag_end > tag && (tag_end[-1] == ' ' || tag_end[-1] == '\t')) {
+            tag_end--;
+        }
+        if (tag_end - tag == 1 && *tag == '*') {
+            return true;
+        }
+        if (tag_end - tag > 2 && tag[0] == 'W' && tag[1] == '/') {
+            tag += 2;
+        }
+        if ((size_t) (tag_end - tag) == etag_len && memcmp(tag, etag, etag_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// narrows a full GET response to the ranges the client asked for, the body references stay in resp
+void apply_ranges(connT *conn, responseT *resp, off_t size, const char *mime, const validatorT *validator) {
+    const sliceT *spec = requestHeader(&conn->req, "Range");
+    if (spec == NULL) {
+        return;
+    }
+    // the client holds another version, it gets the whole current one
+    const sliceT *if_range = requestHeader(&conn->req, "If-Range");
+    if (if_range != NULL && !if_range_matches(if_range, validator)) {
+        return;
+    }
+
+    int n_ranges = rangeParse(*spec, size, resp->ranges);
+    if (n_ranges == 0) {
+        return;
+    }
+
+    if (n_ranges < 0) {
+        logInfo("%s", RANGE_NOT_SATISFIABLE_STR);
+        release_response(resp);
+        resp->bodyLen = 0;
+        resp->status = 416;
+        int rc = snprintf(resp->head, sizeof(resp->head), "%s\r\nContent-Range: bytes */%lld\r\nContent-Length: 0\r\n%s\r\n\r\n",
+                          RANGE_NOT_SATISFIABLE_STR, (long long) size, connection_header(conn));
+        resp->headLen = rc > 0 ? rc : 0;
+        return;
+    }
+
+    int rc;
+    if (n_ranges == 1) {
+        resp->offset = resp->ranges[0].offset;
+        resp->bodyLen = resp->ranges[0].len;
+        rc = render_headers(resp->head, sizeof(resp->head), PARTIAL_CONTENT_STR, resp->bodyLen, mime, validator, NULL);
+        if (rc >= 0) {
+            size_t left = sizeof(resp->head) - rc;
+            int n = snprintf(resp->head + rc, left, "Content-Range: bytes %lld-%lld/%lld\r\n",
+                             (long long) resp->offset, (long long) (resp->offset + resp->bodyLen - 1), (long long) size);
+            resp->headLen = rc + n;
+            rc = n < 0 || (size_t) n >= left ? -1 : 0;
+        }
+    } else {
+        resp->nRanges = n_ranges;
+        rc = render_multipart(resp, size, mime, validator);
+    }
+
+    if (rc < 0 || append_connection(conn, resp) < 0) {
+        release_response(resp);
+        set_error(conn, resp, INT_SERVER_ERR_STR);
+        return;
+    }
+    resp->status = 206;
+}
+
+// If-Range needs a strong match: the exact entity tag (never a weak one) or the exact date
+bool if_range_matches(const sliceT *value, const validatorT *validator) {
+    const char *expected = value->len > 0 && value->ptr[0] == '"' ? validator->etag : validator->lastModified;
+    return value->len == strlen(expected) && memcmp(value->ptr, expected, value->len) == 0;
+}
+
+// the header block goes to resp->head, part headers are only measured here and rendered again as they are sent
+int render_multipart(responseT *resp, off_t size, const char *mime, const validatorT *validator) {
+    resp->boundary = atomic_fetch_add(&boundary_seq, 1);
+    resp->mime = mime;
+    resp->size = size;
+
+    char part_head[PART_HEAD_LEN];
+    off_t body_len = 0;
+    for (int i = 0; i <= resp->nRanges; ++i) {
+        int rc = render_part(resp, i, part_head);
+        if (rc < 0) {
+            return -1;
+        }
+        body_len += rc + (i < resp->nRanges ? resp->ranges[i].len : 0);
+    }
+    resp->offset = 0;
+    resp->bodyLen = body_len;
+
+    char type[sizeof("multipart/byteranges; boundary=") + BOUNDARY_LEN];
+    snprintf(type, sizeof(type), "multipart/byteranges; boundary=%020llu", resp->boundary);
+    int rc = render_headers(resp->head, sizeof(resp->head), PARTIAL_CONTENT_STR, resp->bodyLen, type, validator,
+                            NULL);
+    if (rc < 0) {
+        return -1;
+    }
+    resp->headLen = rc;
+    return 0;
+}
+
+// header of part i into buff of PART_HEAD_LEN, the part past the last range is the closing boundary
+int render_part(responseT *resp, int part, char *buff) {
+    int rc;
+    if (part == resp->nRanges) {
+        rc = snprintf(buff, PART_HEAD_LEN, "\r\n--%020llu--\r\n", resp->boundary);
+    } else {
+        const char *mime = resp->mime;
+        byteRangeT *range = &resp->ranges[part];
+        rc = snprintf(buff, PART_HEAD_LEN, "\r\n--%020llu\r\n%s%s%sContent-Range: bytes %lld-%lld/%lld\r\n\r\n",
+                      resp->boundary, mime != NULL ? "Content-Type: " : "", mime != NULL ? mime : "",
+                      mime != NULL ? "\r\n" : "", (long long) range->offset,
+                      (long long) (range->offset + range->len - 1), (long long) resp->size);
+    }
+    if (rc < 0 || rc >= PART_HEAD_LEN) {
+        logError("formation of multipart headers failed");
+        return -1;
+    }
+    return rc;
+}
+
+// connection header and the empty line closing the header block
+int append_connection(connT *conn, responseT *resp) {
+    size_t left = sizeof(resp->head) - resp->headLen;
+    int n = snprintf(resp->head + resp->headLen, left, "%s\r\n\r\n", connection_header(conn));
+    if (n < 0 || (size_t) n >= left) {
+        logError("formation of headers of http response failed");
+        return -1;
+    }
+    resp->headLen += n;
+    return 0;
+}
+
+const char *connection_header(connT *conn) {
+    return conn->keepAlive ? CONN_KEEP_ALIVE_STR : CONN_CLOSE_STR;
+}
+
+// status line and entity headers, each terminated with CRLF; every file may have encoded variants
+int render_headers(char *buff, size_t size, const char *status, off_t content_len, const char *mime_type,
+                   const validatorT *validator, const char *encoding) {
+    if (mime_type == NULL) {
+        logWarn("could not determine the file type");
+    }
+    int rc = snprintf(buff, size, "%s\r\nContent-Length: %lld\r\n%s%s%s%s%s%sETag: %s\r\nLast-Modified: %s\r\n"
+                                  "Vary: Accept-Encoding\r\nAccept-Ranges: bytes\r\n", status, (long long) content_len,
+                      mime_type != NULL ? "Content-Type: " : "", mime_type != NULL ? mime_type : "",
+                      mime_type != NULL ? "\r\n" : "", encoding != NULL ? "Content-Encoding: " : "",
+                      encoding != NULL ? encoding : "", encoding != NULL ? "\r\n" : "",
+                      validator->etag, validator->lastModified);
+    if (rc < 0 || (size_t) rc >= size) {
+        logError("formation of headers of http response failed");
+        return -1;
+    }
+    return rc;
+}
+
+// reads a small file body into buff, so it no longer needs a sendfile of its own
+bool inline_body(responseT *resp, char *buff, size_t size) {
+    if (resp->file == NULL || resp->nRanges > 0 || resp->bodyLen == 0 || (size_t) resp->bodyLen > size) {
+        return false;
+    }
+    ssize_t n = pread(resp->file->fd, buff, resp->bodyLen, resp->offset);
+    if (n != resp->bodyLen) {
+        // short read of a file truncated under us, the send reports it
+        return false;
+    }
+    resp->body = buff;
+    resp->inlined = true;
+    return true;
+}
+
+// file bodies and multipart bodies do not fit in the gathered write of the headers
+bool has_body_pass(responseT *resp) {
+    return resp->nRanges > 0 || (resp->file != NULL && resp->body == NULL && resp->bodyLen > 0);
+}
+
+// bytes of a response in the gathered write of its batch
+size_t gathered_len(responseT *resp) {
+    return resp->headLen + (resp->body != NULL && resp->nRanges == 0 ? (size_t) resp->bodyLen : 0);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "server.h"
+
+// resolves the request parsed into conn->req to a response, sets conn->keepAlive
+void prepare_response(connT *conn, responseT *resp);
+
+// drops the body references of a response once it is written
+void release_response(responseT *resp);
+
+// header of part `part` of a multipart body rendered into buff (PART_HEAD_LEN bytes),
+// part == nRanges is the closing boundary
+struct iovec response_part(responseT *resp, int part, char *buff);
+
+// serves the pipelined requests of an idle connection and hands it back to its reactor
+void handle_connection(void *arg);
+
+// writes the pre-rendered 503 if the socket takes it right away, the caller closes fd either way
+void send_shed_response(int fd);
+
+// file cache listener: content built from an invalidated file must go too
+void drop_content(void *arg, const char *key);
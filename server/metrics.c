@@ -0,0 +1,273 @@
+#include "metrics.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <threads.h>
+
+#include "../log/log.h"
+
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+
+const int STATUS_CODES[METRICS_STATUS_NUM - 1] = {200, 206, 304, 400, 403, 404, 405, 414, 416, 431, 500, 503};
+
+const char *METHOD_NAMES[METRICS_METHOD_NUM] = {"other", "GET", "HEAD"};
+
+const char *TIMEOUT_NAMES[TIMEOUT_KIND_NUM] = {"header", "idle", "send"};
+
+const char *SHED_NAMES[SHED_REASON_NUM] = {"connections", "overload"};
+
+metricsShardT shards[METRICS_SHARDS];
+
+atomic_uint shards_taken = 0;
+
+thread_local metricsShardT *thread_shard = NULL;
+
+metricsShardT *get_shard();
+
+int status_index(int status);
+
+unsigned long long sum_allocations(int n_shards);
+
+int bucket_index(unsigned long long us);
+
+unsigned long long bucket_limit(int bucket);
+
+void record(histogramT *hist, long long ns);
+
+void sum_histogram(histogramT *hist, unsigned long long *counts, unsigned long long *count, unsigned long long *sum_us);
+
+void write_histogram(FILE *out, const char *name, const char *help, const unsigned long long *counts,
+                     unsigned long long sum_us);
+
+double quantile(const unsigned long long *counts, unsigned long long count, double q);
+
+void metricsResponse(request_method_t method, int status, size_t bytes, long long serviceNs) {
+    metricsShardT *shard = get_shard();
+    atomic_fetch_add_explicit(&shard->requests[method][status_index(status)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&shard->bytesSent, bytes, memory_order_relaxed);
+    record(&shard->service, serviceNs);
+}
+
+void metricsQueueWait(long long waitNs) {
+    record(&get_shard()->queueWait, waitNs);
+}
+
+void metricsSendCalls(unsigned long long n) {
+    atomic_fetch_add_explicit(&get_shard()->sendCalls, n, memory_order_relaxed);
+}
+
+void metricsTimeout(timeoutKindT kind) {
+    atomic_fetch_add_explicit(&get_shard()->timeouts[kind], 1, memory_order_relaxed);
+}
+
+void metricsShed(shedReasonT reason) {
+    atomic_fetch_add_explicit(&get_shard()->shed[reason], 1, memory_order_relaxed);
+}
+
+void metricsAllocations(unsigned long long n) {
+    if (n > 0) {
+        atomic_fetch_add_explicit(&get_shard()->allocations, n, memory_order_relaxed);
+    }
+}
+
+void metricsWrite(FILE *out) {
+    unsigned taken = atomic_load(&shards_taken);
+    int n_shards = taken < METRICS_SHARDS ? (int) taken : METRICS_SHARDS;
+
+    fprintf(out, "# HELP static_server_requests_total Responses written, by request method and status.\n");
+    fprintf(out, "# TYPE static_server_requests_total counter\n");
+    for (int method = 0; method < METRICS_METHOD_NUM; ++method) {
+        for (int status = 0; status < METRICS_STATUS_NUM; ++status) {
+            unsigned long long total = 0;
+            for (int i = 0; i < n_shards; ++i) {
+                total += atomic_load_explicit(&shards[i].requests[method][status], memory_order_relaxed);
+            }
+            if (total == 0) {
+                continue;
+            }
+            if (status < METRICS_STATUS_NUM - 1) {
+                fprintf(out, "static_server_requests_total{method=\"%s\",code=\"%d\"} %llu\n",
+                        METHOD_NAMES[method], STATUS_CODES[status], total);
+            } else {
+                fprintf(out, "static_server_requests_total{method=\"%s\",code=\"other\"} %llu\n",
+                        METHOD_NAMES[method], total);
+            }
+        }
+    }
+
+    unsigned long long bytes = 0;
+    for (int i = 0; i < n_shards; ++i) {
+        bytes += atomic_load_explicit(&shards[i].bytesSent, memory_order_relaxed);
+    }
+    fprintf(out, "# HELP static_server_sent_bytes_total Bytes of headers and bodies written.\n");
+    fprintf(out, "# TYPE static_server_sent_bytes_total counter\n");
+    fprintf(out, "static_server_sent_bytes_total %llu\n", bytes);
+
+    unsigned long long calls = 0;
+    for (int i = 0; i < n_shards; ++i) {
+        calls += atomic_load_explicit(&shards[i].sendCalls, memory_order_relaxed);
+    }
+    fprintf(out, "# HELP static_server_send_calls_total Writes, sendfile and splice calls (io_uring sends and "
+                 "splices in uring mode) carrying responses.\n");
+    fprintf(out, "# TYPE static_server_send_calls_total counter\n");
+    fprintf(out, "static_server_send_calls_total %llu\n", calls);
+
+    fprintf(out, "# HELP static_server_timeouts_total Connections closed at a header, keep-alive or send deadline.\n");
+    fprintf(out, "# TYPE static_server_timeouts_total counter\n");
+    for (int kind = 0; kind < TIMEOUT_KIND_NUM; ++kind) {
+        unsigned long long total = 0;
+        for (int i = 0; i < n_shards; ++i) {
+            total += atomic_load_explicit(&shards[i].timeouts[kind], memory_order_relaxed);
+        }
+        fprintf(out, "static_server_timeouts_total{kind=\"%s\"} %llu\n", TIMEOUT_NAMES[kind], total);
+    }
+
+    fprintf(out, "# HELP static_server_shed_total Connections and requests answered with 503 by the event loop.\n");
+    fprintf(out, "# TYPE static_server_shed_total counter\n");
+    for (int reason = 0; reason < SHED_REASON_NUM; ++reason) {
+        unsigned long long total = 0;
+        for (int i = 0; i < n_shards; ++i) {
+            total += atomic_load_explicit(&shards[i].shed[reason], memory_order_relaxed);
+        }
+        fprintf(out, "static_server_shed_total{reason=\"%s\"} %llu\n", SHED_NAMES[reason], total);
+    }
+
+#ifdef ALLOC_STATS
+    fprintf(out, "# HELP static_server_request_allocations_total Heap allocations while serving requests "
+                 "(cache fills and this endpoint allocate, warm requests should not).\n");
+    fprintf(out, "# TYPE static_server_request_allocations_total counter\n");
+    fprintf(out, "static_server_request_allocations_total %llu\n", sum_allocations(n_shards));
+#endif
+
+    unsigned long long counts[HIST_BUCKETS] = {0};
+    unsigned long long count = 0, sum_us = 0;
+    for (int i = 0; i < n_shards; ++i) {
+        sum_histogram(&shards[i].queueWait, counts, &count, &sum_us);
+    }
+    write_histogram(out, "static_server_queue_wait_seconds",
+                    "Time a ready connection waited in the pool queue (pool mode only).", counts, sum_us);
+
+    memset(counts, 0, sizeof(counts));
+    count = sum_us = 0;
+    for (int i = 0; i < n_shards; ++i) {
+        sum_histogram(&shards[i].service, counts, &count, &sum_us);
+    }
+    write_histogram(out, "static_server_service_seconds", "Time from a parsed request to its response written.",
+                    counts, sum_us);
+}
+
+void metricsLogStats() {
+    unsigned taken = atomic_load(&shards_taken);
+    int n_shards = taken < METRICS_SHARDS ? (int) taken : METRICS_SHARDS;
+
+#ifdef ALLOC_STATS
+    logInfo("heap allocations while serving requests: %llu", sum_allocations(n_shards));
+#endif
+
+    unsigned long long counts[HIST_BUCKETS] = {0};
+    unsigned long long count = 0, sum_us = 0, calls = 0;
+    for (int i = 0; i < n_shards; ++i) {
+        sum_histogram(&shards[i].service, counts, &count, &sum_us);
+        calls += atomic_load_explicit(&shards[i].sendCalls, memory_order_relaxed);
+    }
+    if (count == 0) {
+        return;
+    }
+    logInfo("service time: %llu responses, mean %.1f us, p50 %.0f us, p99 %.0f us, p99.9 %.0f us", count,
+            (double) sum_us / (double) count, quantile(counts, count, 0.5), quantile(counts, count, 0.99),
+            quantile(counts, count, 0.999));
+    logInfo("send calls: %llu, %.2f per response", calls, (double) calls / (double) count);
+}
+
+// the first call of a thread claims the next shard
+metricsShardT *get_shard() {
+    if (thread_shard == NULL) {
+        unsigned num = atomic_fetch_add(&shards_taken, 1);
+        thread_shard = &shards[num < METRICS_SHARDS ? num : METRICS_SHARDS - 1];
+    }
+    return thread_shard;
+}
+
+unsigned long long sum_allocations(int n_shards) {
+    unsigned long long total = 0;
+    for (int i = 0; i < n_shards; ++i) {
+        total += atomic_load_explicit(&shards[i].allocations, memory_order_relaxed);
+    }
+    return total;
+}
+
+int status_index(int status) {
+    int i = 0;
+    for (; i < METRICS_STATUS_NUM - 1 && STATUS_CODES[i] != status; ++i);
+    return i;
+}
+
+int bucket_index(unsigned long long us) {
+    if (us >= 1ull << HIST_MAX_BITS) {
+        us = (1ull << HIST_MAX_BITS) - 1;
+    }
+    if (us < HIST_SUB_COUNT) {
+        return (int) us;
+    }
+    int msb = 63 - __builtin_clzll(us);
+    int octave = msb - HIST_SUB_BITS + 1;
+    return (octave << HIST_SUB_BITS) | (int) ((us >> (msb - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+}
+
+// first value in microseconds past the bucket
+unsigned long long bucket_limit(int bucket) {
+    int octave = bucket >> HIST_SUB_BITS;
+    unsigned long long sub = bucket & (HIST_SUB_COUNT - 1);
+    if (octave == 0) {
+        return sub + 1;
+    }
+    return (HIST_SUB_COUNT + sub + 1) << (octave - 1);
+}
+
+void record(histogramT *hist, long long ns) {
+    unsigned long long us = ns > 0 ? (unsigned long long) ns / 1000 : 0;
+    atomic_fetch_add_explicit(&hist->counts[bucket_index(us)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&hist->sumUs, us, memory_order_relaxed);
+}
+
+void sum_histogram(histogramT *hist, unsigned long long *counts, unsigned long long *count, unsigned long long *sum_us) {
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+        counts[b] += atomic_load_explicit(&hist->counts[b], memory_order_relaxed);
+    }
+    *count += atomic_load_explicit(&hist->count, memory_order_relaxed);
+    *sum_us += atomic_load_explicit(&hist->sumUs, memory_order_relaxed);
+}
+
+// cumulative buckets up to the last non-empty one; the count is the bucket total, so it always matches +Inf
+void write_histogram(FILE *out, const char *name, const char *help, const unsigned long long *counts,
+                     unsigned long long sum_us) {
+    fprintf(out, "# HELP %s %s\n", name, help);
+    fprintf(out, "# TYPE %s histogram\n", name);
+
+    int last = HIST_BUCKETS - 1;
+    while (last >= 0 && counts[last] == 0) {
+        last--;
+    }
+    unsigned long long cumulative = 0;
+    for (int b = 0; b <= last; ++b) {
+        cumulative += counts[b];
+        fprintf(out, "%s_bucket{le=\"%g\"} %llu\n", name, (double) bucket_limit(b) / 1e6, cumulative);
+    }
+    fprintf(out, "%s_bucket{le=\"+Inf\"} %llu\n", name, cumulative);
+    fprintf(out, "%s_sum %g\n", name, (double) sum_us / 1e6);
+    fprintf(out, "%s_count %llu\n", name, cumulative);
+}
+
+// upper bound in microseconds of the bucket holding the q-th sample
+double quantile(const unsigned long long *counts, unsigned long long count, double q) {
+    unsigned long long rank = (unsigned long long) (q * (double) count);
+    unsigned long long seen = 0;
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+        seen += counts[b];
+        if (seen > rank) {
+            return (double) bucket_limit(b);
+        }
+    }
+    return (double) bucket_limit(HIST_BUCKETS - 1);
+}
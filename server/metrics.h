@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "request.h"
+
+// shards handed out to threads, threads beyond them share one (the counters are atomic either way)
+#define METRICS_SHARDS 64
+
+// log-linear latency buckets in microseconds: 8 sub-buckets per power of two, exact below 8 us,
+// within 12.5% up to 2^27 us (~134 s), slower samples land in the last bucket
+#define HIST_SUB_BITS 3
+#define HIST_MAX_BITS 27
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+
+// statuses the server answers with, anything else is counted as "other"
+#define METRICS_STATUS_NUM 13
+#define METRICS_METHOD_NUM (HEAD + 1)
+
+// deadlines a connection parked in its event loop is closed at
+typedef enum timeoutKind {
+    TIMEOUT_HEADER,     // the request header block is incomplete
+    TIMEOUT_IDLE,       // keep-alive connection without a request
+    TIMEOUT_SEND,       // the client stopped taking the response
+    TIMEOUT_KIND_NUM
+} timeoutKindT;
+
+// why a connection was answered with a 503 by its event loop
+typedef enum shedReason {
+    SHED_CONNECTIONS,   // the connection cap is reached
+    SHED_OVERLOAD,      // the pool queue is overloaded or full
+    SHED_REASON_NUM
+} shedReasonT;
+
+typedef struct histogram {
+    atomic_ullong counts[HIST_BUCKETS];
+    atomic_ullong count;
+    atomic_ullong sumUs;
+} histogramT;
+
+// written by its own thread only, summed by the reader
+typedef struct metricsShard {
+    _Alignas(64) atomic_ullong requests[METRICS_METHOD_NUM][METRICS_STATUS_NUM];
+    atomic_ullong bytesSent;
+    atomic_ullong allocations;
+    atomic_ullong sendCalls;
+    atomic_ullong timeouts[TIMEOUT_KIND_NUM];
+    atomic_ullong shed[SHED_REASON_NUM];
+    histogramT queueWait;
+    histogramT service;
+} metricsShardT;
+
+// counts a response once it is written: bytes sent and the time since its request was parsed
+void metricsResponse(request_method_t method, int status, size_t bytes, long long serviceNs);
+
+// time a ready connection spent in the pool queue before a worker took it
+void metricsQueueWait(long long waitNs);
+
+// system calls (io_uring operations in uring mode) that wrote response bytes
+void metricsSendCalls(unsigned long long n);
+
+// connection closed by its event loop at a deadline
+void metricsTimeout(timeoutKindT kind);
+
+// connection or request refused with a 503
+void metricsShed(shedReasonT reason);
+
+// heap allocations made while serving requests, only counted in debug builds
+void metricsAllocations(unsigned long long n);
+
+// aggregate of all threads in the Prometheus text format
+void metricsWrite(FILE *out);
+
+void metricsLogStats();
@@ -0,0 +1,741 @@
+#include "server.h"
+
+#include <sys/eventfd.h>
+
+#include "proactor.h"
+#include "handler.h"
+#include "responses.h"
+#include "metrics.h"
+#include "../event/uring.h"
+#include "../event/clock.h"
+#include "../mem/alloc_stats.h"
+
+#define URING_ENTRIES 256
+#define RECV_BUFS 512
+#define RECV_BUF_GROUP 0
+#define PIPE_CHUNK 65536
+// pipelined input a client may have outstanding beyond the request buffer
+#define SPILL_MAX 65536
+#define PROACTOR_NAME_LEN 16
+
+// operation kind lives in the low bits of user_data, above it the conn or proactor pointer
+#define OP_MASK 0x7u
+#define OP_ACCEPT 1u
+#define OP_WAKE 2u
+#define OP_RECV 3u
+#define OP_SEND 4u
+#define OP_SPLICE_IN 5u
+#define OP_SPLICE_OUT 6u
+#define OP_CANCEL 7u
+
+void *proactor_routine(void *arg);
+
+struct io_uring_sqe *get_sqe(proactorT *proactor);
+
+int arm_accept(proactorT *proactor);
+
+int arm_wake(proactorT *proactor);
+
+int arm_recv(connT *conn);
+
+void handle_cqe(proactorT *proactor, struct io_uring_cqe *cqe);
+
+void on_accept(proactorT *proactor, struct io_uring_cqe *cqe);
+
+void on_recv(connT *conn, struct io_uring_cqe *cqe);
+
+void on_send(connT *conn, int res);
+
+void on_splice_in(connT *conn, int res);
+
+void on_splice_out(connT *conn, int res);
+
+void store_input(connT *conn, const char *data, size_t n);
+
+void process_input(connT *conn);
+
+void start_send(connT *conn);
+
+int submit_sendmsg(connT *conn);
+
+void next_part(connT *conn);
+
+void splice_chunk(connT *conn);
+
+int submit_splice_out(connT *conn, unsigned len);
+
+void finish_response(connT *conn);
+
+void close_conn(connT *conn);
+
+void try_free(connT *conn);
+
+void arm_deadline(connT *conn);
+
+void expire_conn(timerT *timer, void *arg);
+
+bool proactorSupported() {
+    return uringSupported();
+}
+
+proactorT *proactorNew(httpServerT *server, int id, int listenSock) {
+    proactorT *proactor = calloc(1, sizeof(proactorT));
+    if (proactor == NULL) {
+        logFatal(ERR_FSTR, "proactor alloc failed", strerror(errno));
+        return NULL;
+    }
+    proactor->id = id;
+    proactor->server = server;
+    proactor->listenSock = listenSock;
+
+    proactor->conns = slabNew(sizeof(connT));
+    if (proactor->conns == NULL) {
+        free(proactor);
+        return NULL;
+    }
+
+    proactor->timers = timerWheelNew(clockNowMs());
+    if (proactor->timers == NULL) {
+        slabFree(proactor->conns);
+        free(proactor);
+        return NULL;
+    }
+
+    proactor->wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (proactor->wakeFd < 0) {
+        logFatal(ERR_FSTR, "Failed to create eventfd", strerror(errno));
+        timerWheelFree(proactor->timers);
+        slabFree(proactor->conns);
+        free(proactor);
+        return NULL;
+    }
+
+    proactor->ring = uringNew(URING_ENTRIES);
+    if (proactor->ring == NULL) {
+        close(proactor->wakeFd);
+        timerWheelFree(proactor->timers);
+        slabFree(proactor->conns);
+        free(proactor);
+        return NULL;
+    }
+
+    proactor->bufs = uringBufRingNew(proactor->ring, RECV_BUF_GROUP, RECV_BUFS, REQ_SIZE);
+    if (proactor->bufs == NULL) {
+        uringFree(proactor->ring);
+        close(proactor->wakeFd);
+        timerWheelFree(proactor->timers);
+        slabFree(proactor->conns);
+        free(proactor);
+        return NULL;
+    }
+
+    return proactor;
+}
+
+// the proactor must be stopped (or never started on its own thread)
+void proactorFree(proactorT *proactor) {
+    httpServerT *server = proactor->server;
+    for (long i = 0; i < server->nClients; ++i) {
+        connT *conn = server->conns[i];
+        if (conn != NULL && conn->proactor == proactor) {
+            release_response(&conn->resp);
+            connFree(conn);
+            server->conns[i] = NULL;
+        }
+    }
+
+    // closing the ring drops whatever is still in flight
+    uringBufRingFree(proactor->ring, proactor->bufs);
+    uringFree(proactor->ring);
+    close(proactor->listenSock);
+    close(proactor->wakeFd);
+    timerWheelFree(proactor->timers);
+    slabFree(proactor->conns);
+    free(proactor);
+}
+
+int proactorStart(proactorT *proactor) {
+    if (pthread_create(&proactor->thread, NULL, proactor_routine, proactor) != 0) {
+        logFatal(ERR_FSTR, "Failed to create proactor thread", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+void proactorStop(proactorT *proactor) {
+    atomic_store(&proactor->stopping, true);
+
+    uint64_t one = 1;
+    if (write(proactor->wakeFd, &one, sizeof(one)) < 0) {
+        logError(ERR_FSTR, "eventfd write failed", strerror(errno));
+    }
+
+    if (proactor->thread == 0 || pthread_equal(proactor->thread, pthread_self())) {
+        return;
+    }
+
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += 5;
+    if (pthread_timedjoin_np(proactor->thread, NULL, &timeout) == ETIMEDOUT) {
+        pthread_cancel(proactor->thread);
+        pthread_join(proactor->thread, NULL);
+        logDebug("proactor-%d canceled", proactor->id);
+    } else {
+        logDebug("proactor-%d joined", proactor->id);
+    }
+}
+
+void *proactor_routine(void *arg) {
+    proactorT *proactor = (proactorT *) arg;
+
+    char name[PROACTOR_NAME_LEN] = "";
+    sprintf(name, "proactor-%d", proactor->id);
+    threadName = name;
+
+    proactorRun(proactor);
+    return NULL;
+}
+
+int proactorRun(proactorT *proactor) {
+    if (arm_accept(proactor) < 0 || arm_wake(proactor) < 0) {
+        return -1;
+    }
+
+    while (!atomic_load(&proactor->stopping)) {
+        // one io_uring_enter submits everything queued by the previous batch and waits for the next one
+        if (uringSubmitAndWait(proactor->ring, 1, timerWheelTimeout(proactor->timers, clockNowMs())) < 0) {
+            logFatal(ERR_FSTR, "io_uring_enter failed", strerror(errno));
+            return -1;
+        }
+
+        struct io_uring_cqe *cqe;
+        while ((cqe = uringPeekCqe(proactor->ring)) != NULL) {
+            struct io_uring_cqe copy = *cqe;
+            uringCqeSeen(proactor->ring);
+            handle_cqe(proactor, &copy);
+        }
+
+        timerWheelAdvance(proactor->timers, clockNowMs(), expire_conn, proactor);
+    }
+
+    logDebug("proactor stopped");
+    return 0;
+}
+
+// submits what is queued when the submission queue is full
+struct io_uring_sqe *get_sqe(proactorT *proactor) {
+    struct io_uring_sqe *sqe = uringGetSqe(proactor->ring);
+    if (sqe == NULL) {
+        uringSubmitAndWait(proactor->ring, 0, 0);
+        sqe = uringGetSqe(proactor->ring);
+    }
+    if (sqe == NULL) {
+        logError("io_uring submission queue is full");
+    }
+    return sqe;
+}
+
+int arm_accept(proactorT *proactor) {
+    struct io_uring_sqe *sqe = get_sqe(proactor);
+    if (sqe == NULL) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = proactor->listenSock;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = (uint64_t) (uintptr_t) proactor | OP_ACCEPT;
+    return 0;
+}
+
+int arm_wake(proactorT *proactor) {
+    struct io_uring_sqe *sqe = get_sqe(proactor);
+    if (sqe == NULL) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = proactor->wakeFd;
+    sqe->addr = (uint64_t) (uintptr_t) &proactor->wakeBuf;
+    sqe->len = sizeof(proactor->wakeBuf);
+    sqe->off = (uint64_t) -1;
+    sqe->user_data = (uint64_t) (uintptr_t) proactor | OP_WAKE;
+    return 0;
+}
+
+// multishot recv into provided buffers, stays armed across requests
+int arm_recv(connT *conn) {
+    struct io_uring_sqe *sqe = get_sqe(conn->proactor);
+    if (sqe == NULL) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUF_GROUP;
+    sqe->user_data = (uint64_t) (uintptr_t) conn | OP_RECV;
+    conn->inflight++;
+    conn->recvArmed = true;
+    return 0;
+}
+
+void handle_cqe(proactorT *proactor, struct io_uring_cqe *cqe) {
+    unsigned op = cqe->user_data & OP_MASK;
+    void *ptr = (void *) (uintptr_t) (cqe->user_data & ~(uint64_t) OP_MASK);
+
+    switch (op) {
+        case OP_ACCEPT:
+            on_accept(proactor, cqe);
+            return;
+        case OP_WAKE:
+            if (!atomic_load(&proactor->stopping)) {
+                arm_wake(proactor);
+            }
+            return;
+        default:
+            break;
+    }
+
+    connT *conn = (connT *) ptr;
+    if (op == OP_RECV) {
+        on_recv(conn, cqe);
+        return;
+    }
+
+    conn->inflight--;
+    if (conn->closing) {
+        try_free(conn);
+        return;
+    }
+
+    switch (op) {
+        case OP_SEND:
+            on_send(conn, cqe->res);
+            break;
+        case OP_SPLICE_IN:
+            on_splice_in(conn, cqe->res);
+            break;
+        case OP_SPLICE_OUT:
+            on_splice_out(conn, cqe->res);
+            break;
+        default:
+            break;
+    }
+}
+
+void on_accept(proactorT *proactor, struct io_uring_cqe *cqe) {
+    httpServerT *server = proactor->server;
+    if (!(cqe->flags & IORING_CQE_F_MORE) && !atomic_load(&proactor->stopping)) {
+        arm_accept(proactor);
+    }
+
+    int client_sock = cqe->res;
+    if (client_sock < 0) {
+        logError(ERR_FSTR, "accept error", strerror(-client_sock));
+        return;
+    }
+
+    // over the cap: answered and closed before anything is allocated for it
+    if (client_sock >= server->nClients || atomic_load_explicit(&server->nConns, memory_order_relaxed) >=
+                                           server->maxConns) {
+        send_shed_response(client_sock);
+        close(client_sock);
+        metricsShed(SHED_CONNECTIONS);
+        return;
+    }
+
+    connT *conn = connNew(client_sock, server, proactor->conns);
+    if (conn == NULL) {
+        close(client_sock);
+        return;
+    }
+    conn->proactor = proactor;
+
+    if (arm_recv(conn) < 0) {
+        connFree(conn);
+        return;
+    }
+    server->conns[client_sock] = conn;
+    arm_deadline(conn);
+}
+
+void on_recv(connT *conn, struct io_uring_cqe *cqe) {
+    proactorT *proactor = conn->proactor;
+    int res = cqe->res;
+    if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        conn->recvArmed = false;
+        conn->inflight--;
+    }
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        unsigned short bid = (unsigned short) (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        if (res > 0 && !conn->closing) {
+            store_input(conn, uringBuf(proactor->bufs, bid), res);
+        }
+        uringBufRecycle(proactor->bufs, bid);
+    }
+
+    if (conn->closing) {
+        try_free(conn);
+        return;
+    }
+
+    if (res == 0 || (res < 0 && res != -ENOBUFS)) {
+        // orderly shutdown or a receive error
+        close_conn(conn);
+        return;
+    }
+
+    // out of provided buffers stops the multishot recv, just arm it again
+    if (!conn->recvArmed && arm_recv(conn) < 0) {
+        close_conn(conn);
+        return;
+    }
+
+    if (res > 0) {
+        process_input(conn);
+    }
+}
+
+// appends received bytes to the request buffer, what does not fit waits in the spill area
+void store_input(connT *conn, const char *data, size_t n) {
+    if (conn->spillLen == 0) {
+        size_t room = REQ_SIZE - 1 - conn->len;
+        size_t taken = n < room ? n : room;
+        memcpy(conn->buff + conn->len, data, taken);
+        conn->len += taken;
+        data += taken;
+        n -= taken;
+    }
+    if (n == 0) {
+        return;
+    }
+
+    if (conn->spillLen + n > SPILL_MAX) {
+        logWarn("too much pipelined input, closing the connection");
+        close_conn(conn);
+        return;
+    }
+    if (conn->spillLen + n > conn->spillCap) {
+        size_t cap = conn->spillCap > 0 ? conn->spillCap : REQ_SIZE;
+        while (cap < conn->spillLen + n) {
+            cap *= 2;
+        }
+        char *spill = realloc(conn->spill, cap);
+        if (spill == NULL) {
+            logError(ERR_FSTR, "failed to grow spill buffer", strerror(errno));
+            close_conn(conn);
+            return;
+        }
+        conn->spill = spill;
+        conn->spillCap = cap;
+    }
+    memcpy(conn->spill + conn->spillLen, data, n);
+    conn->spillLen += n;
+}
+
+// serves the next buffered request once its header block is complete, one response is in flight at a time
+void process_input(connT *conn) {
+    if (conn->sending || conn->closing || conn->len == 0) {
+        return;
+    }
+    parseStatusT status = parserFeed(&conn->parser, &conn->req, conn->buff, conn->len);
+    if (status == PARSE_MORE) {
+        if (conn->len < REQ_SIZE - 1) {
+            // the header deadline runs from the first bytes of the request
+            if (conn->headerSince == 0) {
+                arm_deadline(conn);
+            }
+            return;
+        }
+        status = conn->parser.status = PARSE_ERROR;
+        conn->parser.error = HEADERS_TOO_LARGE_STR;
+    }
+
+    unsigned long long allocs = allocCount();
+    prepare_response(conn, &conn->resp);
+
+    // pipelined requests behind this one stay buffered, nothing after a malformed request is kept
+    size_t consumed = status == PARSE_DONE ? conn->parser.length : conn->len;
+    conn->len -= consumed;
+    memmove(conn->buff, conn->buff + consumed, conn->len);
+    parserInit(&conn->parser);
+
+    size_t room = REQ_SIZE - 1 - conn->len;
+    size_t refill = conn->spillLen < room ? conn->spillLen : room;
+    if (refill > 0) {
+        memcpy(conn->buff + conn->len, conn->spill, refill);
+        conn->len += refill;
+        conn->spillLen -= refill;
+        memmove(conn->spill, conn->spill + refill, conn->spillLen);
+    }
+
+    start_send(conn);
+    metricsAllocations(allocCount() - allocs);
+}
+
+void start_send(connT *conn) {
+    responseT *resp = &conn->resp;
+    conn->sending = true;
+    conn->part = 0;
+    conn->taken = 0;
+    conn->piped = 0;
+    conn->sent = 0;
+
+    // a multipart body follows part by part once the header block is out
+    bool single = resp->nRanges == 0;
+    conn->segOffset = resp->offset;
+    conn->segLen = single && resp->file != NULL ? resp->bodyLen : 0;
+
+    conn->iov[0].iov_base = resp->head;
+    conn->iov[0].iov_len = resp->headLen;
+    conn->iov[1].iov_base = single && resp->body != NULL ? (char *) resp->body + resp->offset : NULL;
+    conn->iov[1].iov_len = single && resp->body != NULL ? resp->bodyLen : 0;
+
+    memset(&conn->msg, 0, sizeof(conn->msg));
+    conn->msg.msg_iov = conn->iov;
+    conn->msg.msg_iovlen = conn->iov[1].iov_len > 0 ? 2 : 1;
+
+    arm_deadline(conn);
+    if (submit_sendmsg(conn) < 0) {
+        close_conn(conn);
+    }
+}
+
+int submit_sendmsg(connT *conn) {
+    struct io_uring_sqe *sqe = get_sqe(conn->proactor);
+    if (sqe == NULL) {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->fd;
+    sqe->addr = (uint64_t) (uintptr_t) &conn->msg;
+    // more of the body follows right away, let the kernel coalesce it with what is sent now
+    bool more = conn->segLen > 0 || (conn->resp.nRanges > 0 && conn->part <= conn->resp.nRanges);
+    sqe->msg_flags = MSG_NOSIGNAL | (more ? MSG_MORE : 0);
+    sqe->user_data = (uint64_t) (uintptr_t) conn | OP_SEND;
+    conn->inflight++;
+    metricsSendCalls(1);
+    return 0;
+}
+
+void on_send(connT *conn, int res) {
+    if (res < 0) {
+        logError(ERR_FSTR, "send error", strerror(-res));
+        close_conn(conn);
+        return;
+    }
+
+    arm_deadline(conn);
+
+    // skip what was written, resubmit the rest
+    size_t left = (size_t) res;
+    while (conn->msg.msg_iovlen > 0 && left >= conn->msg.msg_iov->iov_len) {
+        left -= conn->msg.msg_iov->iov_len;
+        conn->msg.msg_iov++;
+        conn->msg.msg_iovlen--;
+    }
+    if (conn->msg.msg_iovlen > 0) {
+        conn->msg.msg_iov->iov_base = (char *) conn->msg.msg_iov->iov_base + left;
+        conn->msg.msg_iov->iov_len -= left;
+        if (submit_sendmsg(conn) < 0) {
+            close_conn(conn);
+        }
+        return;
+    }
+
+    if (conn->segLen > 0) {
+        splice_chunk(conn);
+    } else {
+        next_part(conn);
+    }
+}
+
+// sends the next part header of a multipart body with its range when it is in memory
+void next_part(connT *conn) {
+    responseT *resp = &conn->resp;
+    if (resp->nRanges == 0 || conn->part > resp->nRanges) {
+        finish_response(conn);
+        return;
+    }
+
+    int part = conn->part++;
+    conn->iov[0] = response_part(resp, part, conn->partHead);
+    conn->msg.msg_iov = conn->iov;
+    conn->msg.msg_iovlen = 1;
+    conn->segLen = 0;
+    conn->taken = 0;
+    conn->piped = 0;
+    conn->sent = 0;
+    if (part < resp->nRanges) {
+        byteRangeT *range = &resp->ranges[part];
+        if (resp->body != NULL) {
+            conn->iov[1].iov_base = (char *) resp->body + range->offset;
+            conn->iov[1].iov_len = range->len;
+            conn->msg.msg_iovlen = 2;
+        } else {
+            conn->segOffset = range->offset;
+            conn->segLen = range->len;
+        }
+    }
+
+    if (submit_sendmsg(conn) < 0) {
+        close_conn(conn);
+    }
+}
+
+// file -> pipe -> socket, the two splices are linked and go out in one submission
+void splice_chunk(connT *conn) {
+    if (conn->pipe[0] < 0 && pipe2(conn->pipe, O_CLOEXEC) < 0) {
+        logError(ERR_FSTR, "pipe error", strerror(errno));
+        close_conn(conn);
+        return;
+    }
+
+    off_t left = conn->segLen - conn->taken;
+    unsigned len = left < PIPE_CHUNK ? (unsigned) left : PIPE_CHUNK;
+
+    struct io_uring_sqe *in = get_sqe(conn->proactor);
+    if (in == NULL) {
+        close_conn(conn);
+        return;
+    }
+    in->opcode = IORING_OP_SPLICE;
+    in->fd = conn->pipe[1];
+    in->off = (uint64_t) -1;
+    in->splice_fd_in = conn->resp.file->fd;
+    // the fd may be shared with other threads, only offset based transfers are allowed
+    in->splice_off_in = (uint64_t) (conn->segOffset + conn->taken);
+    in->len = len;
+    in->splice_flags = SPLICE_F_MOVE;
+    in->flags = IOSQE_IO_LINK;
+    in->user_data = (uint64_t) (uintptr_t) conn | OP_SPLICE_IN;
+    conn->inflight++;
+
+    // a short splice in fails the link and the splice out completes with -ECANCELED
+    if (submit_splice_out(conn, len) < 0) {
+        close_conn(conn);
+    }
+}
+
+int submit_splice_out(connT *conn, unsigned len) {
+    struct io_uring_sqe *out = get_sqe(conn->proactor);
+    if (out == NULL) {
+        return -1;
+    }
+    out->opcode = IORING_OP_SPLICE;
+    out->fd = conn->fd;
+    out->off = (uint64_t) -1;
+    out->splice_fd_in = conn->pipe[0];
+    out->splice_off_in = (uint64_t) -1;
+    out->len = len;
+    out->splice_flags = SPLICE_F_MOVE;
+    out->user_data = (uint64_t) (uintptr_t) conn | OP_SPLICE_OUT;
+    conn->inflight++;
+    metricsSendCalls(1);
+    return 0;
+}
+
+void on_splice_in(connT *conn, int res) {
+    if (res <= 0) {
+        // error or the file was truncated under us
+        logError(ERR_FSTR, "send file error", res < 0 ? strerror(-res) : "unexpected EOF");
+        close_conn(conn);
+        return;
+    }
+    conn->taken += res;
+    conn->piped += res;
+}
+
+void on_splice_out(connT *conn, int res) {
+    if (res == -ECANCELED) {
+        // short splice in: send what made it into the pipe
+        if (conn->piped > 0 && submit_splice_out(conn, (unsigned) conn->piped) < 0) {
+            close_conn(conn);
+        }
+        return;
+    }
+    if (res <= 0) {
+        logError(ERR_FSTR, "send file error", res < 0 ? strerror(-res) : "connection closed");
+        close_conn(conn);
+        return;
+    }
+
+    arm_deadline(conn);
+    conn->piped -= res;
+    conn->sent += res;
+    if (conn->piped > 0) {
+        if (submit_splice_out(conn, (unsigned) conn->piped) < 0) {
+            close_conn(conn);
+        }
+    } else if (conn->sent < conn->segLen) {
+        splice_chunk(conn);
+    } else {
+        next_part(conn);
+    }
+}
+
+void finish_response(connT *conn) {
+    if (conn->resp.status == 200 || conn->resp.status == 206) {
+        logInfo("successful response");
+    }
+    metricsResponse(conn->resp.method, conn->resp.status, conn->resp.headLen + conn->resp.bodyLen,
+                    clockNowNs() - conn->resp.startNs);
+    release_response(&conn->resp);
+    conn->sending = false;
+
+    if (!conn->keepAlive) {
+        close_conn(conn);
+        return;
+    }
+    arm_deadline(conn);
+
+    // the next request may have arrived while this one was being sent
+    process_input(conn);
+}
+
+// cancels whatever is in flight, the conn is freed once the last completion is in
+void close_conn(connT *conn) {
+    if (conn->closing) {
+        return;
+    }
+    conn->closing = true;
+    conn->keepAlive = false;
+    timerWheelCancel(conn->proactor->timers, &conn->timer);
+
+    if (conn->inflight > 0) {
+        shutdown(conn->fd, SHUT_RDWR);
+        struct io_uring_sqe *sqe = get_sqe(conn->proactor);
+        if (sqe != NULL) {
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = conn->fd;
+            sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+            sqe->user_data = (uint64_t) (uintptr_t) conn | OP_CANCEL;
+            conn->inflight++;
+        }
+    }
+    try_free(conn);
+}
+
+void try_free(connT *conn) {
+    if (!conn->closing || conn->inflight > 0) {
+        return;
+    }
+    conn->server->conns[conn->fd] = NULL;
+    release_response(&conn->resp);
+    connFree(conn);
+}
+
+// the deadline of what the connection waits for now: a request, its rest or the client taking more of a response
+void arm_deadline(connT *conn) {
+    timerWheelSchedule(conn->proactor->timers, &conn->timer, connDeadline(conn, clockNowMs()));
+}
+
+void expire_conn(timerT *timer, void *arg) {
+    (void) arg;
+    connT *conn = (connT *) timer->data;
+    logDebug("connection timed out (fd = %d)", conn->fd);
+    metricsTimeout(conn->timeout);
+    close_conn(conn);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "conn.h"
+
+struct httpServer;
+struct uring;
+struct uringBufRing;
+
+// completion based event loop: accept, recv and send all go through one io_uring
+typedef struct proactor {
+    int id;
+    struct httpServer *server;
+    struct uring *ring;
+    struct uringBufRing *bufs;
+    int listenSock;
+
+    slabT *conns;
+    timerWheelT *timers;
+
+    // eventfd read kept in flight, wakes the loop up on stop
+    int wakeFd;
+    uint64_t wakeBuf;
+
+    pthread_t thread;
+    atomic_bool stopping;
+} proactorT;
+
+bool proactorSupported();
+
+proactorT *proactorNew(struct httpServer *server, int id, int listenSock);
+
+void proactorFree(proactorT *proactor);
+
+int proactorRun(proactorT *proactor);
+
+int proactorStart(proactorT *proactor);
+
+void proactorStop(proactorT *proactor);
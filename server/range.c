@@ -0,0 +1,108 @@
+#include "range.h"
+
+#include <limits.h>
+
+int parse_offset(const char **ptr, const char *end, off_t *value);
+
+const char *skip_space(const char *ptr, const char *end);
+
+int rangeParse(sliceT spec, off_t size, byteRangeT *ranges) {
+    const char *ptr = spec.ptr;
+    const char *end = spec.ptr + spec.len;
+    if (spec.len < sizeof("bytes=") - 1 || strncasecmp(ptr, "bytes=", sizeof("bytes=") - 1) != 0) {
+        return 0;
+    }
+    ptr += sizeof("bytes=") - 1;
+
+    int n_specs = 0, n_ranges = 0;
+    off_t total = 0;
+    while (true) {
+        // empty list elements are allowed
+        while (ptr < end && (*ptr == ',' || *ptr == ' ' || *ptr == '\t')) {
+            ptr++;
+        }
+        if (ptr == end) {
+            break;
+        }
+
+        off_t first = -1, last = -1;
+        if (*ptr != '-' && parse_offset(&ptr, end, &first) < 0) {
+            return 0;
+        }
+        if (ptr == end || *ptr != '-') {
+            return 0;
+        }
+        ptr++;
+        if (ptr < end && *ptr >= '0' && *ptr <= '9' && parse_offset(&ptr, end, &last) < 0) {
+            return 0;
+        }
+        ptr = skip_space(ptr, end);
+        if (ptr < end && *ptr != ',') {
+            return 0;
+        }
+
+        // a syntactically invalid spec makes the whole header invalid
+        if ((first < 0 && last < 0) || (first >= 0 && last >= 0 && last < first)) {
+            return 0;
+        }
+        if (++n_specs > MAX_RANGES) {
+            return 0;
+        }
+
+        byteRangeT range;
+        if (first < 0) {
+            // suffix: the last `last` bytes
+            if (last == 0 || size == 0) {
+                continue;
+            }
+            range.offset = last >= size ? 0 : size - last;
+        } else {
+            if (first >= size) {
+                continue;
+            }
+            range.offset = first;
+        }
+        off_t stop = first < 0 || last < 0 || last >= size ? size - 1 : last;
+        range.len = stop - range.offset + 1;
+
+        total += range.len;
+        ranges[n_ranges++] = range;
+    }
+
+    if (n_specs == 0) {
+        return 0;
+    }
+    if (n_ranges == 0) {
+        return -1;
+    }
+    // overlapping ranges adding up to more than the file are cheaper to answer with the file
+    if (total > size) {
+        return 0;
+    }
+    return n_ranges;
+}
+
+int parse_offset(const char **ptr, const char *end, off_t *value) {
+    const char *cur = *ptr;
+    long long res = 0;
+    while (cur < end && *cur >= '0' && *cur <= '9') {
+        if (res > (LLONG_MAX - (*cur - '0')) / 10) {
+            return -1;
+        }
+        res = res * 10 + (*cur - '0');
+        cur++;
+    }
+    if (cur == *ptr) {
+        return -1;
+    }
+    *ptr = cur;
+    *value = (off_t) res;
+    return 0;
+}
+
+const char *skip_space(const char *ptr, const char *end) {
+    while (ptr < end && (*ptr == ' ' || *ptr == '\t')) {
+        ptr++;
+    }
+    return ptr;
+}
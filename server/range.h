@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "request.h"
+
+// ranges beyond this many are not worth a multipart response, the whole file is sent instead
+#define MAX_RANGES 8
+
+typedef struct byteRange {
+    off_t offset;
+    off_t len;
+} byteRangeT;
+
+// resolves a Range header value against a representation of size bytes: the number of
+// satisfiable ranges, 0 when the header must be ignored, -1 when none of them is satisfiable
+int rangeParse(sliceT spec, off_t size, byteRangeT *ranges);
@@ -0,0 +1,347 @@
+#include "server.h"
+
+#include <sys/eventfd.h>
+
+#include "reactor.h"
+#include "handler.h"
+#include "../event/clock.h"
+
+#define MAX_EVENTS 256
+#define REACTOR_NAME_LEN 16
+
+void *reactor_routine(void *arg);
+
+void accept_clients(reactorT *reactor);
+
+void dispatch_client(reactorT *reactor, int clientfd);
+
+void close_client(reactorT *reactor, connT *conn);
+
+void shed_client(reactorT *reactor, connT *conn);
+
+void finish_conn(reactorT *reactor, connT *conn, long long now);
+
+void collect_returned(reactorT *reactor);
+
+void expire_client(timerT *timer, void *arg);
+
+reactorT *reactorNew(httpServerT *server, int id, int listenSock, bool inlineHandling) {
+    reactorT *reactor = calloc(1, sizeof(reactorT));
+    if (reactor == NULL) {
+        logFatal(ERR_FSTR, "reactor alloc failed", strerror(errno));
+        return NULL;
+    }
+    reactor->id = id;
+    reactor->server = server;
+    reactor->listenSock = listenSock;
+    reactor->inlineHandling = inlineHandling;
+
+    reactor->conns = slabNew(sizeof(connT));
+    if (reactor->conns == NULL) {
+        free(reactor);
+        return NULL;
+    }
+
+    reactor->timers = timerWheelNew(clockNowMs());
+    if (reactor->timers == NULL) {
+        slabFree(reactor->conns);
+        free(reactor);
+        return NULL;
+    }
+
+    reactor->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (reactor->wakeFd < 0) {
+        logFatal(ERR_FSTR, "Failed to create eventfd", strerror(errno));
+        timerWheelFree(reactor->timers);
+        slabFree(reactor->conns);
+        free(reactor);
+        return NULL;
+    }
+    pthread_mutex_init(&reactor->retMutex, NULL);
+
+    reactor->poller = pollerNew(server->engine, server->edgeTriggered, server->nClients);
+    if (reactor->poller == NULL) {
+        pthread_mutex_destroy(&reactor->retMutex);
+        close(reactor->wakeFd);
+        timerWheelFree(reactor->timers);
+        slabFree(reactor->conns);
+        free(reactor);
+        return NULL;
+    }
+
+    // the listener is drained until EAGAIN on every wakeup, so it must not block
+    if (netSetNonBlock(listenSock) < 0 ||
+        pollerAdd(reactor->poller, listenSock, POLLER_IN) < 0 ||
+        pollerAdd(reactor->poller, reactor->wakeFd, POLLER_IN) < 0) {
+        pollerFree(reactor->poller);
+        pthread_mutex_destroy(&reactor->retMutex);
+        close(reactor->wakeFd);
+        timerWheelFree(reactor->timers);
+        slabFree(reactor->conns);
+        free(reactor);
+        return NULL;
+    }
+
+    return reactor;
+}
+
+// the reactor must be stopped (or never started on its own thread)
+void reactorFree(reactorT *reactor) {
+    httpServerT *server = reactor->server;
+    for (long i = 0; i < server->nClients; ++i) {
+        if (server->conns[i] != NULL && server->conns[i]->reactor == reactor) {
+            if (server->conns[i]->sending) {
+                release_response(&server->conns[i]->resp);
+            }
+            connFree(server->conns[i]);
+            server->conns[i] = NULL;
+        }
+    }
+
+    close(reactor->listenSock);
+    pollerFree(reactor->poller);
+    pthread_mutex_destroy(&reactor->retMutex);
+    close(reactor->wakeFd);
+    timerWheelFree(reactor->timers);
+    slabFree(reactor->conns);
+    free(reactor);
+}
+
+int reactorStart(reactorT *reactor) {
+    if (pthread_create(&reactor->thread, NULL, reactor_routine, reactor) != 0) {
+        logFatal(ERR_FSTR, "Failed to create reactor thread", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+void reactorStop(reactorT *reactor) {
+    atomic_store(&reactor->stopping, true);
+
+    uint64_t one = 1;
+    if (write(reactor->wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        logError(ERR_FSTR, "eventfd write failed", strerror(errno));
+    }
+
+    if (reactor->thread == 0 || pthread_equal(reactor->thread, pthread_self())) {
+        return;
+    }
+
+    struct timespec timeout;
+    clock_gettime(CLOCK_REALTIME, &timeout);
+    timeout.tv_sec += 5;
+    if (pthread_timedjoin_np(reactor->thread, NULL, &timeout) == ETIMEDOUT) {
+        pthread_cancel(reactor->thread);
+        pthread_join(reactor->thread, NULL);
+        logDebug("reactor-%d canceled", reactor->id);
+    } else {
+        logDebug("reactor-%d joined", reactor->id);
+    }
+}
+
+void *reactor_routine(void *arg) {
+    reactorT *reactor = (reactorT *) arg;
+
+    char name[REACTOR_NAME_LEN] = "";
+    sprintf(name, "reactor-%d", reactor->id);
+    threadName = name;
+
+    reactorRun(reactor);
+    return NULL;
+}
+
+int reactorRun(reactorT *reactor) {
+    pollerEventT events[MAX_EVENTS];
+    while (!atomic_load(&reactor->stopping)) {
+        int n_ready = pollerWait(reactor->poller, events, MAX_EVENTS,
+                                  timerWheelTimeout(reactor->timers, clockNowMs()));
+        if (n_ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logFatal(ERR_FSTR, "event loop error", strerror(errno));
+            return -1;
+        }
+
+        for (int i = 0; i < n_ready; ++i) {
+            if (events[i].fd == reactor->listenSock) {
+                accept_clients(reactor);
+                continue;
+            }
+            if (events[i].fd == reactor->wakeFd) {
+                collect_returned(reactor);
+                continue;
+            }
+
+            if (events[i].events & (POLLER_IN | POLLER_OUT | POLLER_ERR)) {
+                dispatch_client(reactor, events[i].fd);
+            }
+        }
+
+        // closes the connections whose deadline passed
+        timerWheelAdvance(reactor->timers, clockNowMs(), expire_client, reactor);
+    }
+
+    logDebug("reactor stopped");
+    return 0;
+}
+
+// takes the whole backlog in one wakeup, a burst of connections costs one poll round
+void accept_clients(reactorT *reactor) {
+    httpServerT *server = reactor->server;
+    while (true) {
+        int client_sock = netAccept(reactor->listenSock);
+        if (client_sock < 0 && (errno == EINTR || errno == ECONNABORTED)) {
+            continue;
+        }
+        if (client_sock < 0) {
+            return;
+        }
+
+        // over the cap: answered and closed before anything is allocated for it
+        if (client_sock >= server->nClients || atomic_load_explicit(&server->nConns, memory_order_relaxed) >=
+                                               server->maxConns) {
+            send_shed_response(client_sock);
+            close(client_sock);
+            metricsShed(SHED_CONNECTIONS);
+            continue;
+        }
+        // workers never wait for the socket (accepted non-blocking), what it cannot take is parked until writable
+        connT *conn = connNew(client_sock, server, reactor->conns);
+        if (conn == NULL) {
+            close(client_sock);
+            continue;
+        }
+        conn->reactor = reactor;
+
+        // deferred accept hands over connections with their request received: dispatched right away and left
+        // unpolled, finish_conn registers the fd once the connection is handed back like any other busy one
+        if (server->deferAccept) {
+            server->conns[client_sock] = conn;
+            dispatch_client(reactor, client_sock);
+            continue;
+        }
+
+        if (pollerAdd(reactor->poller, client_sock, POLLER_IN | POLLER_ONESHOT) < 0) {
+            connFree(conn);
+            continue;
+        }
+        server->conns[client_sock] = conn;
+        timerWheelSchedule(reactor->timers, &conn->timer, connDeadline(conn, clockNowMs()));
+    }
+}
+
+void dispatch_client(reactorT *reactor, int clientfd) {
+    connT *conn = reactor->server->conns[clientfd];
+    if (conn == NULL || (conn->state != CONN_IDLE && conn->state != CONN_WRITING)) {
+        return;
+    }
+
+    // the fd is disarmed (oneshot) and the deadline off until the connection is handed back
+    timerWheelCancel(reactor->timers, &conn->timer);
+    conn->state = CONN_BUSY;
+
+    if (reactor->inlineHandling) {
+        handle_connection(conn);
+        return;
+    }
+
+    // new requests are queued only while the queue keeps up, a parked response was admitted already
+    long long now = clockNowNs();
+    if (!conn->sending && admissionOverloaded(&reactor->server->admission, now)) {
+        shed_client(reactor, conn);
+        return;
+    }
+
+    conn->queuedAt = now;
+    taskT task = {.handler = handle_connection, .arg = conn};
+    if (tPoolAddTask(reactor->server->tPool, &task) != 0) {
+        if (conn->sending) {
+            close_client(reactor, conn);
+        } else {
+            shed_client(reactor, conn);
+        }
+    }
+}
+
+// answers the request with a 503 instead of queueing it, the connection is closed after it
+void shed_client(reactorT *reactor, connT *conn) {
+    // unread input would turn the close into a reset the response may be lost in
+    netRead(conn->fd, conn->buff, REQ_SIZE - 1);
+    send_shed_response(conn->fd);
+    metricsShed(SHED_OVERLOAD);
+    close_client(reactor, conn);
+}
+
+void close_client(reactorT *reactor, connT *conn) {
+    timerWheelCancel(reactor->timers, &conn->timer);
+    pollerDel(reactor->poller, conn->fd);
+    reactor->server->conns[conn->fd] = NULL;
+    if (conn->sending) {
+        release_response(&conn->resp);
+    }
+    connFree(conn);
+}
+
+void finish_conn(reactorT *reactor, connT *conn, long long now) {
+    uint32_t events = conn->state == CONN_WRITING ? POLLER_OUT : POLLER_IN;
+    if (conn->state == CONN_CLOSE || pollerMod(reactor->poller, conn->fd, events | POLLER_ONESHOT) < 0) {
+        close_client(reactor, conn);
+        return;
+    }
+    // a parked send gets a fresh deadline whenever it made progress
+    timerWheelSchedule(reactor->timers, &conn->timer, connDeadline(conn, now));
+}
+
+// called once a worker is done with the connection: re-arm it for state or close it on its reactor
+void reactorReturnConn(connT *conn, connStateT state) {
+    reactorT *reactor = conn->reactor;
+    conn->state = state;
+
+    if (reactor->inlineHandling) {
+        finish_conn(reactor, conn, clockNowMs());
+        return;
+    }
+
+    pthread_mutex_lock(&reactor->retMutex);
+    // ===== CRITICAL SECTION =====
+    conn->retNext = reactor->retHead;
+    reactor->retHead = conn;
+    // ============================
+    pthread_mutex_unlock(&reactor->retMutex);
+
+    uint64_t one = 1;
+    if (write(reactor->wakeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        logError(ERR_FSTR, "eventfd write failed", strerror(errno));
+    }
+}
+
+void collect_returned(reactorT *reactor) {
+    uint64_t cnt;
+    if (read(reactor->wakeFd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN) {
+        logError(ERR_FSTR, "eventfd read failed", strerror(errno));
+    }
+
+    pthread_mutex_lock(&reactor->retMutex);
+    // ===== CRITICAL SECTION =====
+    connT *conn = reactor->retHead;
+    reactor->retHead = NULL;
+    // ============================
+    pthread_mutex_unlock(&reactor->retMutex);
+
+    long long now = clockNowMs();
+    while (conn != NULL) {
+        connT *next = conn->retNext;
+        conn->retNext = NULL;
+        finish_conn(reactor, conn, now);
+        conn = next;
+    }
+}
+
+void expire_client(timerT *timer, void *arg) {
+    reactorT *reactor = (reactorT *) arg;
+    connT *conn = (connT *) timer->data;
+    logDebug("connection timed out (fd = %d)", conn->fd);
+    metricsTimeout(conn->timeout);
+    close_client(reactor, conn);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "../event/poller.h"
+#include "../queue/task.h"
+#include "conn.h"
+
+struct httpServer;
+
+typedef struct reactor {
+    int id;
+    struct httpServer *server;
+    pollerT *poller;
+    int listenSock;
+    // serve connections on the reactor thread instead of handing them to the pool
+    bool inlineHandling;
+
+    // connections are created, freed and timed on the reactor thread only
+    slabT *conns;
+    timerWheelT *timers;
+
+    // connections handed back by workers; also wakes the loop up on stop
+    int wakeFd;
+    pthread_mutex_t retMutex;
+    connT *retHead;
+
+    pthread_t thread;
+    atomic_bool stopping;
+} reactorT;
+
+reactorT *reactorNew(struct httpServer *server, int id, int listenSock, bool inlineHandling);
+
+void reactorFree(reactorT *reactor);
+
+int reactorRun(reactorT *reactor);
+
+int reactorStart(reactorT *reactor);
+
+void reactorStop(reactorT *reactor);
+
+void reactorReturnConn(connT *conn, connStateT state);
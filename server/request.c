@@ -1,71 +1,258 @@
 #include "request.h"
-
+#include "responses.h"
+#include "scan.h"
 
 #include "../log/log.h"
 
-request_method_t parse_method(char *method);
+int parse_request_line(httpParserT *parser, requestT *req, char *line, size_t len);
 
-int validate_version(char *version);
+int normalize_path(char *dst, const char *src, size_t len);
 
-int parse_req(requestT *req, char *buff) {
-    char *saveptr = NULL;
+void parse_header(requestT *req, char *line, size_t len);
 
-    char *http_query = strtok_r(buff, "\n", &saveptr);
-    if (http_query == NULL) {
-        logError(ERR_FSTR, "failed parse http query string", strerror(errno));
-        return -1;
+request_method_t parse_method(sliceT method);
+
+bool has_token(sliceT value, const char *token);
+
+sliceT trim(const char *ptr, size_t len);
+
+void parserInit(httpParserT *parser) {
+    parser->status = PARSE_MORE;
+    parser->requestLine = true;
+    parser->pos = 0;
+    parser->length = 0;
+    parser->error = NULL;
+}
+
+// consumes complete lines of buff[0, len) from where the previous call stopped
+parseStatusT parserFeed(httpParserT *parser, requestT *req, char *buff, size_t len) {
+    if (parser->status != PARSE_MORE) {
+        return parser->status;
+    }
+    if (parser->pos == 0) {
+        req->method = BAD;
+        req->url = NULL;
+        req->version = HTTP10;
+        req->keepAlive = false;
+        req->nHeaders = 0;
     }
-    logInfo(http_query);
 
-    char *http_method = strtok_r(http_query, " ", &saveptr);
-    if (http_method == NULL) {
-        logError(ERR_FSTR, "failed parse http method", strerror(errno));
-        return -1;
+    const char *end = buff + len;
+    while (parser->pos < len) {
+        char *line = buff + parser->pos;
+        const char *nl = scanByte(line, end, '\n');
+        if (nl == NULL) {
+            return PARSE_MORE;
+        }
+
+        size_t line_len = nl - line;
+        parser->pos += line_len + 1;
+        if (line_len > 0 && line[line_len - 1] == '\r') {
+            line_len--;
+        }
+
+        if (parser->requestLine) {
+            // empty lines before the request line are allowed
+            if (line_len == 0) {
+                continue;
+            }
+            if (parse_request_line(parser, req, line, line_len) < 0) {
+                parser->status = PARSE_ERROR;
+                return PARSE_ERROR;
+            }
+            parser->requestLine = false;
+            continue;
+        }
+
+        if (line_len == 0) {
+            // the url is only set on a complete request
+            req->url = req->path[0] == '\0' ? "index.html" : req->path;
+            parser->length = parser->pos;
+            parser->status = PARSE_DONE;
+            return PARSE_DONE;
+        }
+        parse_header(req, line, line_len);
     }
-    req->method = parse_method(http_method);
-    if (req->method == BAD) {
-        return 0;
+    return PARSE_MORE;
+}
+
+int parse_req(requestT *req, char *buff) {
+    httpParserT parser;
+    parserInit(&parser);
+
+    size_t len = strlen(buff);
+    parseStatusT status = parserFeed(&parser, req, buff, len);
+    if (status == PARSE_MORE) {
+        return 1;
     }
-    logDebug("method: %s - %d", http_method, req->method);
+    return status == PARSE_DONE ? 0 : -1;
+}
 
-    char *http_url = strtok_r(NULL, " ", &saveptr);
-    if (http_url == NULL) {
-        logError(ERR_FSTR, "failed parse url", strerror(errno));
+int parse_request_line(httpParserT *parser, requestT *req, char *line, size_t len) {
+    logInfo("%.*s", (int) len, line);
+    parser->error = BAD_REQUEST_STR;
+
+    const char *end = line + len;
+    char *method_end = (char *) scanByte(line, end, ' ');
+    if (method_end == NULL) {
+        logError("failed parse http method");
         return -1;
     }
-    if (strcmp(http_url, "/") == 0)
-        strcpy(req->url, "index.html");
-    else
-        strcpy(req->url, http_url + 1);
-    logDebug("url: %s ", req->url);
+    req->method = parse_method((sliceT) {line, method_end - line});
 
-    char *http_version = strtok_r(NULL, "\r", &saveptr);
-    if (http_version == NULL) {
-        logError(ERR_FSTR, "failed http version", strerror(errno));
+    char *url = method_end + 1;
+    char *url_end = (char *) scanByte(url, end, ' ');
+    if (url_end == NULL || url == url_end || *url != '/') {
+        logError("failed parse url");
+        return -1;
+    }
+    if (url_end - url >= URL_LEN) {
+        logError("url too long");
+        parser->error = URI_TOO_LONG_STR;
         return -1;
     }
-    if (validate_version(http_version) == 0) {
+
+    sliceT version = {url_end + 1, end - url_end - 1};
+    if (version.len == strlen(HTTP11_STR) && memcmp(version.ptr, HTTP11_STR, version.len) == 0) {
+        req->version = HTTP11;
+    } else if (version.len == strlen(HTTP10_STR) && memcmp(version.ptr, HTTP10_STR, version.len) == 0) {
+        req->version = HTTP10;
+    } else {
         logError("unsupported http version");
         return -1;
     }
-    logDebug("version: %s ", http_version);
+    // HTTP/1.1 connections are persistent by default, HTTP/1.0 ones are not
+    req->keepAlive = req->version == HTTP11;
 
+    // the buffer itself stays as received, a request behind a parked response is parsed again
+    if (normalize_path(req->path, url, url_end - url) < 0) {
+        logError("url leaves the root: %.*s", (int) (url_end - url), url);
+        parser->error = FORBIDDEN_STR;
+        return -1;
+    }
     return 0;
 }
 
-request_method_t parse_method(char *method) {
-    if (strcmp(GET_STR, method) == 0) {
+// copies the url without its leading slash the way a lookup beneath the root walks it; -1 when ".." climbs
+// above the root. dst takes up to len bytes
+int normalize_path(char *dst, const char *src, size_t len) {
+    const char *end = src + len;
+    size_t out = 0;
+    while (src < end) {
+        while (src < end && *src == '/') {
+            src++;
+        }
+        const char *segment = src;
+        while (src < end && *src != '/') {
+            src++;
+        }
+
+        size_t segment_len = src - segment;
+        if (segment_len == 0 || (segment_len == 1 && segment[0] == '.')) {
+            continue;
+        }
+        if (segment_len == 2 && segment[0] == '.' && segment[1] == '.') {
+            if (out == 0) {
+                return -1;
+            }
+            // drop the last segment with the slash in front of it
+            while (out > 0 && dst[out - 1] != '/') {
+                out--;
+            }
+            if (out > 0) {
+                out--;
+            }
+            continue;
+        }
+
+        if (out > 0) {
+            dst[out++] = '/';
+        }
+        memcpy(dst + out, segment, segment_len);
+        out += segment_len;
+    }
+    // "file/" names a directory, as it does for the lookup
+    if (out > 0 && end[-1] == '/') {
+        dst[out++] = '/';
+    }
+    dst[out] = '\0';
+    return (int) out;
+}
+
+void parse_header(requestT *req, char *line, size_t len) {
+    const char *colon = scanByte(line, line + len, ':');
+    if (colon == NULL || colon == line) {
+        return;
+    }
+
+    sliceT name = {line, colon - line};
+    sliceT value = trim(colon + 1, line + len - colon - 1);
+
+    if (sliceEqualsCase(name, CONNECTION_HDR)) {
+        if (has_token(value, "close")) {
+            req->keepAlive = false;
+        } else if (has_token(value, "keep-alive")) {
+            req->keepAlive = true;
+        }
+    }
+
+    if (req->nHeaders < MAX_HEADERS) {
+        req->headers[req->nHeaders].name = name;
+        req->headers[req->nHeaders].value = value;
+        req->nHeaders++;
+    }
+}
+
+const sliceT *requestHeader(const requestT *req, const char *name) {
+    for (int i = 0; i < req->nHeaders; ++i) {
+        if (sliceEqualsCase(req->headers[i].name, name)) {
+            return &req->headers[i].value;
+        }
+    }
+    return NULL;
+}
+
+bool sliceEqualsCase(sliceT slice, const char *str) {
+    return strlen(str) == slice.len && strncasecmp(slice.ptr, str, slice.len) == 0;
+}
+
+// checks a comma separated header value for a case-insensitive token
+bool has_token(sliceT value, const char *token) {
+    size_t token_len = strlen(token);
+    const char *ptr = value.ptr;
+    const char *end = value.ptr + value.len;
+    while (ptr < end) {
+        while (ptr < end && (*ptr == ' ' || *ptr == '\t' || *ptr == ',')) {
+            ptr++;
+        }
+        const char *start = ptr;
+        while (ptr < end && *ptr != ',' && *ptr != ' ' && *ptr != '\t') {
+            ptr++;
+        }
+        if ((size_t) (ptr - start) == token_len && strncasecmp(start, token, token_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+request_method_t parse_method(sliceT method) {
+    if (method.len == strlen(GET_STR) && memcmp(method.ptr, GET_STR, method.len) == 0) {
         return GET;
     }
-    if (strcmp(HEAD_STR, method) == 0) {
+    if (method.len == strlen(HEAD_STR) && memcmp(method.ptr, HEAD_STR, method.len) == 0) {
         return HEAD;
     }
     return BAD;
 }
 
-int validate_version(char *version) {
-    if (strcmp(HTTP11_STR, version) == 0 || strcmp(HTTP10_STR, version) == 0) {
-        return 1;
+sliceT trim(const char *ptr, size_t len) {
+    while (len > 0 && (*ptr == ' ' || *ptr == '\t')) {
+        ptr++;
+        len--;
     }
-    return 0;
+    while (len > 0 && (ptr[len - 1] == ' ' || ptr[len - 1] == '\t')) {
+        len--;
+    }
+    return (sliceT) {ptr, len};
 }
@@ -1,6 +1,9 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
 
 #define GET_STR "GET"
@@ -9,15 +12,69 @@
 #define HTTP11_STR "HTTP/1.1"
 #define HTTP10_STR "HTTP/1.0"
 
+#define CONNECTION_HDR "Connection"
+
 #define URL_LEN 128
+#define MAX_HEADERS 32
 
 typedef enum requestMethod {
     BAD, GET, HEAD
 } request_method_t;
 
+typedef enum httpVersion {
+    HTTP10, HTTP11
+} http_version_t;
+
+// view into the request buffer, not NUL-terminated
+typedef struct slice {
+    const char *ptr;
+    size_t len;
+} sliceT;
+
+typedef struct header {
+    sliceT name;
+    sliceT value;
+} headerT;
+
 typedef struct request {
     request_method_t method;
-    char url[URL_LEN];
+    // path relative to the root as rootOpen resolves it, so every spelling of a file is one cache key:
+    // repeated slashes collapsed, "." segments dropped and ".." resolved; points into path or at "index.html",
+    // NULL until the header block is complete
+    const char *url;
+    char path[URL_LEN];
+    http_version_t version;
+    bool keepAlive;
+
+    headerT headers[MAX_HEADERS];
+    int nHeaders;
 } requestT;
 
+typedef enum parseStatus {
+    PARSE_MORE,     // header block incomplete, feed again once more bytes arrived
+    PARSE_DONE,
+    PARSE_ERROR
+} parseStatusT;
+
+// resumable request parser: keeps its position between reads of the same buffer
+typedef struct httpParser {
+    parseStatusT status;
+    bool requestLine;
+    size_t pos;
+    // bytes taken by the request once parsed
+    size_t length;
+    // status line to answer a malformed request with
+    const char *error;
+} httpParserT;
+
+void parserInit(httpParserT *parser);
+
+parseStatusT parserFeed(httpParserT *parser, requestT *req, char *buff, size_t len);
+
+// parses a NUL-terminated request: 0 once it is complete, 1 while its header block is unfinished (the url is
+// not set yet), -1 when it is malformed
 int parse_req(requestT *req, char *buff);
+
+const sliceT *requestHeader(const requestT *req, const char *name);
+
+bool sliceEqualsCase(sliceT slice, const char *str);
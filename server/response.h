@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "../cache/content_cache.h"
+#include "../cache/file_cache.h"
+#include "../cache/variant_cache.h"
+#include "range.h"
+
+#define HEADER_LEN 512
+// part header of a multipart/byteranges body: boundary, Content-Type and Content-Range
+#define PART_HEAD_LEN 192
+
+// a response ready to be written: the header block and an optional body
+typedef struct response {
+    int status;
+    char head[HEADER_LEN];
+    size_t headLen;
+
+    // what the metrics count it under once it is written
+    request_method_t method;
+    long long startNs;
+
+    // body from memory (kept alive by entry or variant, or rendered for this response and owned by it)
+    // or a range of an open file
+    cacheEntryT *entry;
+    variantT *variant;
+    char *generated;
+    const char *body;
+    // body read from file into a worker's batch buffer, body is the range itself; file and offset still hold it
+    bool inlined;
+    fileEntryT *file;
+    off_t offset;
+    off_t bodyLen;
+
+    // multipart/byteranges: each range is preceded by its part header, the closing boundary comes last;
+    // the headers are rendered as they are sent, bodyLen covers the whole multipart body
+    int nRanges;
+    byteRangeT ranges[MAX_RANGES];
+    unsigned long long boundary;
+    const char *mime;
+    off_t size;
+} responseT;
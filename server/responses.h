@@ -1,8 +1,22 @@
 #pragma once
 
 #define OK_STR "HTTP/1.1 200 OK"
-#define BAD_REQUEST_STR "HTTP/1.1 400 Bad Request\r\n\r\n"
-#define FORBIDDEN_STR "HTTP/1.1 403 Forbidden\r\n\r\n"
-#define NOT_FOUND_STR "HTTP/1.1 404 Not Found\r\n\r\n"
-#define M_NOT_ALLOWED_STR "HTTP/1.1 405 Method Not Allowed\r\n\r\n"
-#define INT_SERVER_ERR_STR "HTTP/1.1 500 Internal Server Error\r\n\r\n"
+#define PARTIAL_CONTENT_STR "HTTP/1.1 206 Partial Content"
+#define NOT_MODIFIED_STR "HTTP/1.1 304 Not Modified"
+#define BAD_REQUEST_STR "HTTP/1.1 400 Bad Request"
+#define FORBIDDEN_STR "HTTP/1.1 403 Forbidden"
+#define NOT_FOUND_STR "HTTP/1.1 404 Not Found"
+#define M_NOT_ALLOWED_STR "HTTP/1.1 405 Method Not Allowed"
+#define URI_TOO_LONG_STR "HTTP/1.1 414 URI Too Long"
+#define RANGE_NOT_SATISFIABLE_STR "HTTP/1.1 416 Range Not Satisfiable"
+#define HEADERS_TOO_LARGE_STR "HTTP/1.1 431 Request Header Fields Too Large"
+#define INT_SERVER_ERR_STR "HTTP/1.1 500 Internal Server Error"
+#define SERVICE_UNAVAILABLE_STR "HTTP/1.1 503 Service Unavailable"
+
+#define METRICS_TYPE "text/plain; version=0.0.4; charset=utf-8"
+
+#define CONN_CLOSE_STR "Connection: close"
+#define CONN_KEEP_ALIVE_STR "Connection: keep-alive"
+
+// written by the event loop itself to connections and requests the server sheds
+#define SHED_RESPONSE SERVICE_UNAVAILABLE_STR "\r\nRetry-After: 1\r\n" CONN_CLOSE_STR "\r\nContent-Length: 0\r\n\r\n"
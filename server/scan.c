@@ -0,0 +1,64 @@
+#include "scan.h"
+
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+const char *scan_sse2(const char *ptr, const char *end, char c);
+
+const char *scan_avx2(const char *ptr, const char *end, char c);
+
+void scan_init();
+
+const char *(*scan_impl)(const char *, const char *, char) = scan_sse2;
+
+__attribute__((constructor)) void scan_init() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scan_impl = scan_avx2;
+    }
+}
+
+const char *scanByte(const char *ptr, const char *end, char c) {
+    return scan_impl(ptr, end, c);
+}
+
+const char *scan_sse2(const char *ptr, const char *end, char c) {
+    __m128i needle = _mm_set1_epi8(c);
+    while (end - ptr >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) ptr);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask != 0) {
+            return ptr + __builtin_ctz(mask);
+        }
+        ptr += 16;
+    }
+    for (; ptr < end; ++ptr) {
+        if (*ptr == c) {
+            return ptr;
+        }
+    }
+    return NULL;
+}
+
+__attribute__((target("avx2"))) const char *scan_avx2(const char *ptr, const char *end, char c) {
+    __m256i needle = _mm256_set1_epi8(c);
+    while (end - ptr >= 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) ptr);
+        unsigned mask = (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle));
+        if (mask != 0) {
+            return ptr + __builtin_ctz(mask);
+        }
+        ptr += 32;
+    }
+    return scan_sse2(ptr, end, c);
+}
+
+#else
+
+const char *scanByte(const char *ptr, const char *end, char c) {
+    return ptr < end ? memchr(ptr, c, end - ptr) : NULL;
+}
+
+#endif
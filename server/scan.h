@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stddef.h>
+
+// first occurrence of c in [ptr, end) or NULL; SSE2/AVX2 on x86-64, picked once at startup
+const char *scanByte(const char *ptr, const char *end, char c);
@@ -1,39 +1,16 @@
 #include "server.h"
-#include "request.h"
-#include "responses.h"
-#include "content_type.h"
+#include "handler.h"
 
 #define PATH_MAX 256
-#define HEADER_LEN 128
 
-void handle_connection(int clientfd, char *wd);
+int start_reactors(httpServerT *server);
 
-taskT *new_task_t(handlerT handler, int conn, char *wd);
+int start_proactors(httpServerT *server);
 
-int read_req(char *buff, int clientfd);
+const char *server_mode_name(serverModeT mode);
 
-void send_resp(char *path, int client_fd, request_method_t type);
-
-void send_err(int clientfd, const char *str);
-
-void process_req(int clientfd, requestT *req, char *wd);
-
-bool is_prefix(char *prefix, char *str);
-
-void send_file(char *path, int clientfd);
-
-void process_get_req(char *path, int clientfd);
-
-void process_head_req(char *path, int clientfd);
-
-int send_headers(char *path, int clientfd);
-
-char *get_type(char *path);
-
-char *get_content_type(char *path);
-
-httpServerT *httpServerNew(const char *host, int port, int nThreads, const char *wd) {
-    if (chdir(wd)) {
+httpServerT *httpServerNew(const httpServerConfigT *config) {
+    if (chdir(config->wd)) {
         logFatal(ERR_FSTR, "Failed to change work dir", strerror(errno));
         return NULL;
     }
@@ -43,8 +20,26 @@ httpServerT *httpServerNew(const char *host, int port, int nThreads, const char
         return NULL;
     }
 
-    strcpy(server->host, host);
-    server->port = port;
+    strcpy(server->host, config->host);
+    server->port = config->port;
+    server->mode = config->mode;
+    if (server->mode == SERVER_URING && !proactorSupported()) {
+        logWarn("io_uring is not available, falling back to reuseport mode");
+        server->mode = SERVER_REUSEPORT;
+    }
+    server->engine = config->engine;
+    server->edgeTriggered = config->edgeTriggered;
+    server->keepAliveTimeoutMs = (long long) config->keepAliveTimeout * 1000;
+    server->keepAliveMax = config->keepAliveMax;
+    server->headerTimeoutMs = (long long) config->headerTimeout * 1000;
+    server->sendTimeoutMs = (long long) config->sendTimeout * 1000;
+    server->deferAccept = config->deferAccept;
+    server->fastOpenQueue = config->fastOpenQueue;
+    server->sendBuffer = config->sendBuffer;
+    admissionInit(&server->admission, (long long) config->queueTargetMs * 1000000);
+    server->sendMode = config->sendMode;
+    server->nReactors = server->mode == SERVER_REUSEPORT ? config->nThreads : server->mode == SERVER_POOL ? 1 : 0;
+    server->nProactors = server->mode == SERVER_URING ? config->nThreads : 0;
 
     server->nClients = sysconf(_SC_OPEN_MAX);
     if (server->nClients < 0) {
@@ -52,30 +47,65 @@ httpServerT *httpServerNew(const char *host, int port, int nThreads, const char
         free(server);
         return NULL;
     }
+    server->maxConns = config->maxConns > 0 && config->maxConns < server->nClients ? config->maxConns :
+                       (int) server->nClients;
 
-    server->clients = malloc(sizeof(struct pollfd) * server->nClients);
-    if (server->clients == NULL) {
-        logFatal(ERR_FSTR, "Failed to alloc clients fds", strerror(errno));
+    server->conns = calloc(server->nClients, sizeof(connT *));
+    if (server->conns == NULL) {
+        logFatal(ERR_FSTR, "Failed to alloc conns", strerror(errno));
         free(server);
         return NULL;
     }
 
-    for (long i = 0; i < server->nClients; ++i) {
-        server->clients[i].fd = -1;
-    }
-
-    server->tPool = tPoolNew(nThreads);
-    if (server->tPool == NULL) {
-        free(server->clients);
+    server->reactors = calloc(server->nReactors, sizeof(reactorT *));
+    server->proactors = calloc(server->nProactors, sizeof(proactorT *));
+    if (server->reactors == NULL || server->proactors == NULL) {
+        logFatal(ERR_FSTR, "Failed to alloc event loops", strerror(errno));
+        free(server->reactors);
+        free(server->proactors);
+        free(server->conns);
         free(server);
         return NULL;
     }
 
+    // reuseport reactors serve connections themselves
+    if (server->mode == SERVER_POOL) {
+        server->tPool = tPoolNewSched(config->nThreads, config->sched);
+        if (server->tPool == NULL) {
+            free(server->reactors);
+            free(server->proactors);
+            free(server->conns);
+            free(server);
+            return NULL;
+        }
+    }
+
+    if (config->cacheBudget > 0) {
+        server->cache = contentCacheNew(config->cacheBudget, config->cacheMaxObject, config->cacheAdmitHits);
+        if (server->cache == NULL) {
+            if (server->tPool != NULL) {
+                tPoolFree(server->tPool);
+            }
+            free(server->reactors);
+            free(server->proactors);
+            free(server->conns);
+            free(server);
+            return NULL;
+        }
+    }
+
     server->wd = calloc(PATH_MAX, sizeof(char));
     if (server->wd == NULL) {
         logFatal(ERR_FSTR, "Failed to alloc wd", strerror(errno));
-        tPoolFree(server->tPool);
-        free(server->clients);
+        if (server->cache != NULL) {
+            contentCacheFree(server->cache);
+        }
+        if (server->tPool != NULL) {
+            tPoolFree(server->tPool);
+        }
+        free(server->reactors);
+        free(server->proactors);
+        free(server->conns);
         free(server);
         return NULL;
     }
@@ -83,360 +113,267 @@ httpServerT *httpServerNew(const char *host, int port, int nThreads, const char
     if (getcwd(server->wd, PATH_MAX) == NULL) {
         logFatal(ERR_FSTR, "Failed to get wd", strerror(errno));
         free(server->wd);
-        tPoolFree(server->tPool);
-        free(server->clients);
+        if (server->cache != NULL) {
+            contentCacheFree(server->cache);
+        }
+        if (server->tPool != NULL) {
+            tPoolFree(server->tPool);
+        }
+        free(server->reactors);
+        free(server->proactors);
+        free(server->conns);
         free(server);
         return NULL;
     }
 
-    logInfo("Server created");
-    return server;
-}
-
-void httpServerFree(httpServerT *server) {
-    server->clients[0].revents = -1;
-    close(server->listenSock);
-
-    tPoolStop(server->tPool);
-    tPoolFree(server->tPool);
-
-    free(server->wd);
-    free(server->clients);
-    free(server);
-
-    logInfo("server destroyed");
-}
-
-int httpServerStart(httpServerT *server) {
-    logInfo("Server starting");
-    logInfo("Host: %s", server->host);
-    logInfo("Port: %d", server->port);
-    logInfo("Work dir: %s", server->wd);
-
-    server->listenSock = netListen(server->host, server->port);
-    if (server->listenSock < 0) {
-        return -1;
-    }
-
-    if (tPoolStart(server->tPool) != 0) {
-        return -1;
+    server->rootFd = rootDirOpen(server->wd);
+    if (server->rootFd < 0) {
+        free(server->wd);
+        if (server->cache != NULL) {
+            contentCacheFree(server->cache);
+        }
+        if (server->tPool != NULL) {
+            tPoolFree(server->tPool);
+        }
+        free(server->reactors);
+        free(server->proactors);
+        free(server->conns);
+        free(server);
+        return NULL;
     }
 
-    long max_i = 0, n_ready;
-    server->clients[0].fd = server->listenSock;
-    server->clients[0].events = POLLIN;
-
-    while (true) {
-        n_ready = poll(server->clients, max_i + 1, -1);
-        if (n_ready < 0) {
-            logFatal(ERR_FSTR, "poll error", strerror(errno));
-            return -1;
+    if (config->fileCacheEntries > 0) {
+        server->files = fileCacheNew(server->wd, config->fileCacheEntries);
+        if (server->files != NULL && fileCacheStart(server->files) < 0) {
+            logWarn("file cache disabled");
+            fileCacheFree(server->files);
+            server->files = NULL;
         }
-
-        if (server->clients[0].revents & POLLIN) {
-            int client_sock = netAccept(server->listenSock);
-            if (client_sock < 0) {
-                continue;
-            }
-
-            long i = 0;
-            for (i = 1; i < server->nClients; ++i) {
-                if (server->clients[i].fd < 0) {
-                    server->clients[i].fd = client_sock;
-                    break;
-                }
-            }
-            if (i == server->nClients) {
-                logError("too many connections");
-                continue;
-            }
-            server->clients[i].events = POLLIN;
-
-            if (i > max_i) {
-                max_i = i;
-            }
-            if (--n_ready <= 0) {
-                continue;
-            }
+        if (server->files != NULL && server->cache != NULL) {
+            fileCacheSetListener(server->files, drop_content, server->cache);
         }
+    }
 
-        for (int i = 1; i <= max_i; ++i) {
-            if (server->clients[i].fd < 0) {
-                continue;
-            }
+    // urls are matched without their leading slash
+    if (config->metricsPath != NULL && config->metricsPath[0] != '\0') {
+        const char *path = config->metricsPath[0] == '/' ? config->metricsPath + 1 : config->metricsPath;
+        server->metricsPath = strdup(path);
+    }
 
-            if (server->clients[i].revents & (POLLIN | POLLERR)) {
-                taskT *task = new_task_t(handle_connection, server->clients[i].fd, server->wd);
-                if (task == NULL) {
-                    continue;
-                }
+    // sidecars are always negotiated, the budget only bounds background compression
+    server->variants = variantCacheNew(server->rootFd, config->compressBudget, config->cacheMaxObject);
+    if (server->variants != NULL && variantCacheStart(server->variants) < 0) {
+        logWarn("content negotiation disabled");
+        variantCacheFree(server->variants);
+        server->variants = NULL;
+    }
 
-                tPoolAddTask(server->tPool, task);
-                server->clients[i].fd = -1;
+    logInfo("Server created");
+    return server;
+}
 
-                if (--n_ready <= 0) {
-                    break;
-                }
-            }
+void httpServerFree(httpServerT *server) {
+    for (int i = 0; i < server->nReactors; ++i) {
+        if (server->reactors[i] != NULL) {
+            reactorStop(server->reactors[i]);
         }
     }
-}
-
-void handle_connection(int clientfd, char *wd) {
-    requestT req;
-    char *buff = calloc(REQ_SIZE, sizeof(char));
-    if (buff == NULL) {
-        logError(ERR_FSTR, "failed alloc req buf", strerror(errno));
-        return;
+    for (int i = 0; i < server->nProactors; ++i) {
+        if (server->proactors[i] != NULL) {
+            proactorStop(server->proactors[i]);
+        }
     }
 
-    logDebug("handle_connection started");
-    if (read_req(buff, clientfd) < 0) {
-        send_err(clientfd, INT_SERVER_ERR_STR);
-        close(clientfd);
-        free(buff);
-        return;
+    if (server->tPool != NULL) {
+        tPoolStop(server->tPool);
+        tPoolFree(server->tPool);
     }
-    logDebug("read_req");
 
-    if (parse_req(&req, buff) < 0) {
-        send_err(clientfd, BAD_REQUEST_STR);
-        close(clientfd);
-        free(buff);
-        return;
+    for (int i = 0; i < server->nReactors; ++i) {
+        if (server->reactors[i] != NULL) {
+            reactorFree(server->reactors[i]);
+        }
     }
-    if (req.method == BAD) {
-        logError("unsupported http method");
-        send_err(clientfd, M_NOT_ALLOWED_STR);
-        close(clientfd);
-        free(buff);
-        return;
+    for (int i = 0; i < server->nProactors; ++i) {
+        if (server->proactors[i] != NULL) {
+            proactorFree(server->proactors[i]);
+        }
     }
 
-    process_req(clientfd, &req, wd);
-
-    close(clientfd);
-    logDebug("handle_connection finished");
+    unsigned long long conditionals = atomic_load(&server->conditionals);
+    unsigned long long not_modified = atomic_load(&server->notModified);
+    logInfo("conditional requests: %llu, not modified %llu (%.1f%%)", conditionals, not_modified,
+            conditionals > 0 ? 100.0 * (double) not_modified / (double) conditionals : 0.0);
 
-    free(buff);
-}
+    metricsLogStats();
 
-taskT *new_task_t(handlerT handler, int conn, char *wd) {
-    taskT *task = calloc(1, sizeof(taskT));
-    if (task == NULL) {
-        logError(ERR_FSTR, "task alloc failed", strerror(errno));
-        return NULL;
+    if (server->variants != NULL) {
+        variantCacheLogStats(server->variants);
+        variantCacheFree(server->variants);
     }
-    task->wd = wd;
-    task->conn = conn;
-    task->handler = handler;
-    return task;
-}
-
-int read_req(char *buff, int clientfd) {
-    logDebug("read_req in");
-    long byte_read = netRead(clientfd, buff, REQ_SIZE - 1);
-    if (byte_read <= 0) {
-        return -1;
+    // the file cache notifies the content cache, so it goes first
+    if (server->files != NULL) {
+        fileCacheLogStats(server->files);
+        fileCacheFree(server->files);
+    }
+    if (server->cache != NULL) {
+        contentCacheLogStats(server->cache);
+        contentCacheFree(server->cache);
     }
 
-    buff[byte_read - 1] = '\0';
-    logDebug("%s", buff);
+    close(server->rootFd);
 
-    return 0;
-}
+    free(server->reactors);
+    free(server->proactors);
+    free(server->conns);
+    free(server->wd);
+    free(server->metricsPath);
+    free(server);
 
-void process_req(int clientfd, requestT *req, char *wd) {
-    char *path = calloc(PATH_MAX, sizeof(char));
-    if (path == NULL) {
-        logError(ERR_FSTR, "failed alloc path buf", strerror(errno));
-        send_err(clientfd, INT_SERVER_ERR_STR);
-        return;
-    }
+    logInfo("server destroyed");
+}
 
-    if (realpath(req->url, path) == NULL) {
-        if (errno == ENOENT) {
-            send_err(clientfd, NOT_FOUND_STR);
-        } else {
-            send_err(clientfd, INT_SERVER_ERR_STR);
+int httpServerStart(httpServerT *server) {
+    logInfo("Server starting");
+    logInfo("Host: %s", server->host);
+    logInfo("Port: %d", server->port);
+    logInfo("Work dir: %s", server->wd);
+    logInfo("Mode: %s (%d event loops)", server_mode_name(server->mode), server->nReactors + server->nProactors);
+    logInfo("Keep-alive: timeout %lld ms, max %d requests", server->keepAliveTimeoutMs, server->keepAliveMax);
+    logInfo("Timeouts: header %lld ms, send %lld ms", server->headerTimeoutMs, server->sendTimeoutMs);
+    logInfo("Listener: defer accept %d s, fast open queue %d, send buffer %d bytes", server->deferAccept,
+            server->fastOpenQueue, server->sendBuffer);
+    logInfo("Admission: %d connections, pool queue wait target %lld ms", server->maxConns,
+            server->admission.targetNs / 1000000);
+    logInfo("File transmission: %s", netSendModeName(server->sendMode));
+    if (server->cache != NULL) {
+        logInfo("Content cache: %zu bytes, files up to %zu bytes", server->cache->budget, server->cache->maxObject);
+    }
+    if (server->variants != NULL) {
+        logInfo("Compressed variants: %zu bytes", server->variants->budget);
+    }
+    if (server->metricsPath != NULL) {
+        logInfo("Metrics: /%s", server->metricsPath);
+    }
+
+    if (server->mode == SERVER_URING) {
+        if (start_proactors(server) < 0) {
+            return -1;
         }
-        logError(ERR_FSTR, "realpath error", strerror(errno));
-        free(path);
-        return;
+        logInfo("Event loop: io_uring");
+        // proactor 0 runs on the calling thread
+        return proactorRun(server->proactors[0]);
     }
-    logDebug("path: %s", path);
 
-    if (!is_prefix(wd, path)) {
-        send_err(clientfd, FORBIDDEN_STR);
-        logError("attempt to access outside the root");
-        free(path);
-        return;
+    if (start_reactors(server) < 0) {
+        return -1;
     }
+    logInfo("Event loop: %s", pollerName(server->reactors[0]->poller));
 
-    send_resp(req->url, clientfd, GET);
-    free(path);
-}
-
-bool is_prefix(char *prefix, char *str) {
-    while (*prefix && *str && *prefix++ == *str++);
-
-    if (*prefix == '\0') {
-        return true;
+    if (server->tPool != NULL && tPoolStart(server->tPool) != 0) {
+        return -1;
     }
-    return false;
-}
 
-void send_resp(char *path, int client_fd, request_method_t type) {
-    switch (type) {
-        case GET:
-            process_get_req(path, client_fd);
-            break;
-        case HEAD:
-            process_head_req(path, client_fd);
-            break;
-        default:
-            logError("unsupported http method");
-            send_err(client_fd, M_NOT_ALLOWED_STR);
-            break;
-    }
+    // reactor 0 runs on the calling thread
+    return reactorRun(server->reactors[0]);
 }
 
-void process_get_req(char *path, int clientfd) {
-    logDebug("process as GET");
-    if (send_headers(path, clientfd) < 0) {
-        return;
+void httpServerWriteMetrics(httpServerT *server, FILE *out) {
+    if (server->tPool != NULL) {
+        fprintf(out, "# HELP static_server_queue_length Ready connections waiting for a pool worker.\n");
+        fprintf(out, "# TYPE static_server_queue_length gauge\n");
+        fprintf(out, "static_server_queue_length %zu\n", tPoolQueueLen(server->tPool));
     }
 
-    send_file(path, clientfd);
-}
+    fprintf(out, "# HELP static_server_connections Open client connections.\n");
+    fprintf(out, "# TYPE static_server_connections gauge\n");
+    fprintf(out, "static_server_connections %d\n", atomic_load(&server->nConns));
 
-void process_head_req(char *path, int clientfd) {
-    logDebug("process as HEAD");
-    send_headers(path, clientfd);
-}
-
-int send_headers(char *path, int clientfd) {
-    char status[] = OK_STR;
-    char connection[] = "Connection: close";
+    fprintf(out, "# HELP static_server_conditional_requests_total Requests with If-None-Match or If-Modified-Since.\n");
+    fprintf(out, "# TYPE static_server_conditional_requests_total counter\n");
+    fprintf(out, "static_server_conditional_requests_total %llu\n", atomic_load(&server->conditionals));
+    fprintf(out, "# HELP static_server_not_modified_total Conditional requests answered with 304.\n");
+    fprintf(out, "# TYPE static_server_not_modified_total counter\n");
+    fprintf(out, "static_server_not_modified_total %llu\n", atomic_load(&server->notModified));
 
-    char *len = calloc(HEADER_LEN, sizeof(char));
-    char *type = calloc(HEADER_LEN, sizeof(char));
-    if (len == NULL || type == NULL) {
-        logError(ERR_FSTR, "failed to alloc headers buffs", strerror(errno));
-        send_err(clientfd, INT_SERVER_ERR_STR);
-        return -1;
+    fprintf(out, "# HELP static_server_cache_hits_total Lookups served from a cache.\n");
+    fprintf(out, "# TYPE static_server_cache_hits_total counter\n");
+    if (server->cache != NULL) {
+        fprintf(out, "static_server_cache_hits_total{cache=\"content\"} %llu\n", atomic_load(&server->cache->hits));
     }
-
-    struct stat st;
-    if (stat(path, &st) < 0) {
-        send_err(clientfd, NOT_FOUND_STR);
-        perror("stat error");
-        free(len);
-        free(type);
-        return -1;
+    if (server->files != NULL) {
+        fprintf(out, "static_server_cache_hits_total{cache=\"file\"} %llu\n", atomic_load(&server->files->hits));
     }
-
-    sprintf(len, "Content-Length: %ld", st.st_size);
-    char *mime_type = get_content_type(path);
-
-    int rc = 0;
-    char *res_str;
-    if (mime_type == NULL) {
-        logWarn("could not determine the file type");
-        rc = asprintf(&res_str, "%s\r\n%s\r\n%s\r\n\r\n", status, connection, len);
-    } else {
-        sprintf(type, "Content-Type: %s", mime_type);
-        rc = asprintf(&res_str, "%s\r\n%s\r\n%s\r\n%s\r\n\r\n", status, connection, len, type);
+    if (server->variants != NULL) {
+        fprintf(out, "static_server_cache_hits_total{cache=\"variant\"} %llu\n",
+                atomic_load(&server->variants->hits));
     }
-    if (rc < 0) {
-        logError("formation of headers of http response failed");
-        send_err(clientfd, INT_SERVER_ERR_STR);
-        free(len);
-        free(type);
-        return -1;
+    fprintf(out, "# HELP static_server_cache_misses_total Lookups the cache could not serve.\n");
+    fprintf(out, "# TYPE static_server_cache_misses_total counter\n");
+    if (server->cache != NULL) {
+        fprintf(out, "static_server_cache_misses_total{cache=\"content\"} %llu\n",
+                atomic_load(&server->cache->misses));
     }
-
-    ssize_t byte_write = netWrite(clientfd, res_str, rc);
-    if (byte_write < 0) {
-        free(res_str);
-        free(len);
-        free(type);
-        return -1;
+    if (server->files != NULL) {
+        fprintf(out, "static_server_cache_misses_total{cache=\"file\"} %llu\n", atomic_load(&server->files->misses));
+    }
+    if (server->variants != NULL) {
+        fprintf(out, "static_server_cache_misses_total{cache=\"variant\"} %llu\n",
+                atomic_load(&server->variants->misses));
     }
-
-    logDebug("headers: %s", res_str);
-    logDebug("send %d bytes", byte_write);
-
-    free(res_str);
-    free(len);
-    free(type);
-    return 0;
 }
 
-void send_file(char *path, int clientfd) {
-    int fd = open(path, 0);
-    if (fd < 0) {
-        logError(ERR_FSTR, "open error", strerror(errno));
-        send_err(clientfd, NOT_FOUND_STR);
-        return;
-    }
+int start_reactors(httpServerT *server) {
+    bool reuse_port = server->mode == SERVER_REUSEPORT;
 
-    char *buff_resp = calloc(RESP_SIZE, sizeof(char));
-    if (buff_resp == NULL) {
-        logError(ERR_FSTR, "failed alloc resp buf", strerror(errno));
-        send_err(clientfd, INT_SERVER_ERR_STR);
-        return;
-    }
-    unsigned long long total_read = 0, total_write = 0;
-    long byte_write = 0, byte_read = 0;
+    for (int i = 0; i < server->nReactors; ++i) {
+        int listen_sock = netListen(server->host, server->port, reuse_port, server->deferAccept, server->fastOpenQueue,
+                                    server->sendBuffer);
+        if (listen_sock < 0) {
+            return -1;
+        }
 
-    while ((byte_read = netRead(fd, buff_resp, RESP_SIZE)) > 0) {
-        total_read += byte_read;
+        server->reactors[i] = reactorNew(server, i, listen_sock, reuse_port);
+        if (server->reactors[i] == NULL) {
+            close(listen_sock);
+            return -1;
+        }
 
-        byte_write = write(clientfd, buff_resp, byte_read);
-        if (byte_write < 0) {
-            logError(ERR_FSTR, "write error", strerror(errno));
-            break;
+        if (i > 0 && reactorStart(server->reactors[i]) < 0) {
+            return -1;
         }
-        total_write += byte_write;
     }
-    logDebug("total read %llu bytes", total_read);
-    logDebug("total sent %llu bytes", total_write);
-
-    close(fd);
-    logInfo("successful response");
-
-    free(buff_resp);
+    return 0;
 }
 
-void send_err(int clientfd, const char *str) {
-    logInfo("%s", str);
-    netWrite(clientfd, str, strlen(str));
-}
+int start_proactors(httpServerT *server) {
+    for (int i = 0; i < server->nProactors; ++i) {
+        int listen_sock = netListen(server->host, server->port, true, server->deferAccept, server->fastOpenQueue,
+                                    server->sendBuffer);
+        if (listen_sock < 0) {
+            return -1;
+        }
 
-char *get_type(char *path) {
-    char *res = path + strlen(path) - 1;
-    while (res >= path && *res != '.' && *res != '/') {
-        res--;
-    }
+        server->proactors[i] = proactorNew(server, i, listen_sock);
+        if (server->proactors[i] == NULL) {
+            close(listen_sock);
+            return -1;
+        }
 
-    if (res < path || *res == '/') {
-        return NULL;
+        if (i > 0 && proactorStart(server->proactors[i]) < 0) {
+            return -1;
+        }
     }
-    return ++res;
+    return 0;
 }
 
-char *get_content_type(char *path) {
-    char *ext = get_type(path);
-    if (ext == NULL) {
-        return NULL;
-    }
-
-    int i = 0;
-    for (; i < TYPE_NUM && strcmp(TYPE_EXT[i], ext) != 0; i++);
-    if (i >= TYPE_NUM) {
-        return NULL;
+const char *server_mode_name(serverModeT mode) {
+    switch (mode) {
+        case SERVER_REUSEPORT:
+            return "reuseport";
+        case SERVER_URING:
+            return "uring";
+        default:
+            return "pool";
     }
-
-    return MIME_TYPE[i];
 }
@@ -1,6 +1,7 @@
 #pragma once
 
-#include <poll.h>
+#define _GNU_SOURCE
+
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -11,24 +12,128 @@
 
 #include "../tpool/t_pool.h"
 #include "../net/net.h"
+#include "../event/poller.h"
+#include "../cache/content_cache.h"
+#include "../cache/file_cache.h"
+#include "../cache/variant_cache.h"
+#include "../fs/root.h"
+#include "metrics.h"
+#include "admission.h"
+#include "conn.h"
+#include "reactor.h"
+#include "proactor.h"
 
 #define HOST_SIZE 16
 
+typedef enum serverMode {
+    // one acceptor/event loop thread dispatching requests to the thread pool
+    SERVER_POOL,
+    // one SO_REUSEPORT listener and event loop per thread, requests served in place
+    SERVER_REUSEPORT,
+    // like reuseport, but accept, recv and send go through a per-thread io_uring
+    SERVER_URING
+} serverModeT;
+
+typedef struct httpServerConfig {
+    const char *host;
+    int port;
+    int nThreads;
+    const char *wd;
+
+    serverModeT mode;
+    // task scheduling of the pool mode
+    tPoolSchedT sched;
+    pollerTypeT engine;
+    bool edgeTriggered;
+
+    // keep-alive: idle timeout in seconds (0 disables) and requests per connection
+    int keepAliveTimeout;
+    int keepAliveMax;
+    // seconds to receive a complete request header block and between two writes of a response (0 disables)
+    int headerTimeout;
+    int sendTimeout;
+
+    // listener options: seconds TCP_DEFER_ACCEPT waits for the request, TCP_FASTOPEN queue length and the
+    // SO_SNDBUF bytes accepted connections inherit (0 disables)
+    int deferAccept;
+    int fastOpenQueue;
+    int sendBuffer;
+
+    // open connections of all event loops (0 leaves only the fd limit), pool queue wait target (0 disables)
+    int maxConns;
+    int queueTargetMs;
+
+    sendModeT sendMode;
+
+    // hot-file cache: byte budget (0 disables), largest cached file, misses before admission
+    size_t cacheBudget;
+    size_t cacheMaxObject;
+    int cacheAdmitHits;
+
+    // open file / metadata cache size in entries (0 disables)
+    size_t fileCacheEntries;
+
+    // memory for bodies compressed in the background (0 leaves only precompressed sidecars)
+    size_t compressBudget;
+
+    // url serving the metrics, NULL or empty disables it
+    const char *metricsPath;
+} httpServerConfigT;
+
 typedef struct httpServer {
     char host[HOST_SIZE];
     int port;
 
-    struct pollfd *clients;
+    serverModeT mode;
+    pollerTypeT engine;
+    bool edgeTriggered;
+
+    reactorT **reactors;
+    int nReactors;
+    proactorT **proactors;
+    int nProactors;
+
+    // connections of all reactors by fd
     long nClients;
+    connT **conns;
+
+    long long keepAliveTimeoutMs;
+    int keepAliveMax;
+    long long headerTimeoutMs;
+    long long sendTimeoutMs;
+
+    int deferAccept;
+    int fastOpenQueue;
+    int sendBuffer;
+
+    // connections beyond maxConns are answered with a 503 right after accept
+    int maxConns;
+    atomic_int nConns;
+    // pool mode: requests are answered with a 503 instead of queued while the queue wait stays above the target
+    admissionT admission;
+    sendModeT sendMode;
+    contentCacheT *cache;
+    fileCacheT *files;
+    variantCacheT *variants;
+
+    // conditional GET/HEAD requests and how many of them were answered with 304
+    atomic_ullong conditionals, notModified;
+
+    // metrics url relative to the root like request urls, NULL when disabled
+    char *metricsPath;
 
-    int listenSock;
     tPoolT *tPool;
 
     char *wd;
+    // O_PATH descriptor of wd, files are opened beneath it
+    int rootFd;
 } httpServerT;
 
-httpServerT *httpServerNew(const char *host, int port, int nThreads, const char *wd);
+httpServerT *httpServerNew(const httpServerConfigT *config);
 
 void httpServerFree(httpServerT *server);
 
 int httpServerStart(httpServerT *server);
+
+// gauges and cache counters in the Prometheus text format, the request metrics come from metricsWrite
+void httpServerWriteMetrics(httpServerT *server, FILE *out);
@@ -0,0 +1,311 @@
+// pipelined requests to a client that does not read: the server parks the response the socket has no room for
+// and has to answer the requests buffered behind it intact once the client drains the connection; then a slow
+// reader of one large body, whose send parks and resumes many times, has to receive it intact.
+//
+// usage: pipeline_test server port [server args...]   (run from the repository root)
+
+#define _GNU_SOURCE
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define HOST "127.0.0.1"
+#define URL "/img/workspaces.png"
+#define FILE_PATH "./static/img/workspaces.png"
+#define N_REQUESTS 8
+// small enough for the first responses to fill the socket
+#define RCVBUF 4096
+#define SERVER_START_MS 5000
+#define IO_TIMEOUT_S 10
+#define HEAD_MAX 4096
+// the slow reader takes this much at a time, then pauses
+#define SLOW_CHUNK 16384
+#define SLOW_PAUSE_US 5000
+
+pid_t start_server(int argc, char *argv[]);
+
+void stop_server(pid_t pid);
+
+int connect_client(int port);
+
+char *read_file(const char *path, size_t *len);
+
+int check_pipelined(int port, const char *expected, size_t file_len, char *body);
+
+int check_slow_reader(int port, const char *expected, size_t file_len, char *body);
+
+int read_head(int fd, char *head, size_t head_max, int *status, size_t *len);
+
+int read_response(int fd, char *head, size_t head_max, char *body, size_t body_max, int *status, size_t *len);
+
+ssize_t read_full(int fd, char *buff, size_t n);
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s server port [server args...]\n", argv[0]);
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    size_t file_len;
+    char *expected = read_file(FILE_PATH, &file_len);
+    if (expected == NULL) {
+        return 2;
+    }
+    char *body = malloc(file_len);
+    if (body == NULL) {
+        free(expected);
+        return 2;
+    }
+
+    pid_t pid = start_server(argc, argv);
+    if (pid < 0) {
+        free(body);
+        free(expected);
+        return 2;
+    }
+
+    int port = atoi(argv[2]);
+    int failed = check_pipelined(port, expected, file_len, body);
+    failed |= check_slow_reader(port, expected, file_len, body);
+
+    stop_server(pid);
+    free(body);
+    free(expected);
+    return failed;
+}
+
+int check_pipelined(int port, const char *expected, size_t file_len, char *body) {
+    int failed = 0;
+    int fd = connect_client(port);
+    if (fd < 0) {
+        failed = 1;
+    }
+
+    char req[256];
+    int req_len = snprintf(req, sizeof(req), "GET " URL " HTTP/1.1\r\nHost: " HOST "\r\n\r\n");
+    for (int i = 0; !failed && i < N_REQUESTS; ++i) {
+        if (send(fd, req, req_len, 0) != req_len) {
+            perror("send");
+            failed = 1;
+        }
+    }
+    // the server runs into the full socket before anything is read
+    usleep(500 * 1000);
+
+    char head[HEAD_MAX];
+    for (int i = 0; !failed && i < N_REQUESTS; ++i) {
+        int status;
+        size_t len;
+        if (read_response(fd, head, sizeof(head), body, file_len, &status, &len) < 0) {
+            fprintf(stderr, "response %d: connection closed or malformed\n", i + 1);
+            failed = 1;
+        } else if (status != 200 || len != file_len || memcmp(body, expected, file_len) != 0) {
+            fprintf(stderr, "response %d: status %d, %zu of %zu bytes, body %s\n", i + 1, status, len, file_len,
+                    len == file_len && memcmp(body, expected, file_len) == 0 ? "intact" : "differs");
+            failed = 1;
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    printf("%s: %d pipelined responses to a blocked client\n", failed ? "FAIL" : "OK", N_REQUESTS);
+    return failed;
+}
+
+// the body is read a chunk at a time with pauses, so the server keeps finding the socket full
+int check_slow_reader(int port, const char *expected, size_t file_len, char *body) {
+    int failed = 0;
+    int fd = connect_client(port);
+    if (fd < 0) {
+        failed = 1;
+    }
+
+    char req[256];
+    int req_len = snprintf(req, sizeof(req), "GET " URL " HTTP/1.1\r\nHost: " HOST "\r\n\r\n");
+    if (!failed && send(fd, req, req_len, 0) != req_len) {
+        perror("send");
+        failed = 1;
+    }
+
+    char head[HEAD_MAX];
+    int status = 0;
+    size_t len = 0;
+    if (!failed && read_head(fd, head, sizeof(head), &status, &len) < 0) {
+        fprintf(stderr, "slow reader: connection closed or malformed\n");
+        failed = 1;
+    }
+
+    size_t got = 0;
+    while (!failed && got < file_len) {
+        size_t chunk = file_len - got < SLOW_CHUNK ? file_len - got : SLOW_CHUNK;
+        ssize_t rc = read(fd, body + got, chunk);
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            break;
+        }
+        got += rc;
+        usleep(SLOW_PAUSE_US);
+    }
+    if (!failed && (status != 200 || len != file_len || got != file_len || memcmp(body, expected, file_len) != 0)) {
+        fprintf(stderr, "slow reader: status %d, %zu of %zu bytes, body %s\n", status, got, file_len,
+                got == file_len && memcmp(body, expected, file_len) == 0 ? "intact" : "differs");
+        failed = 1;
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    printf("%s: %zu byte body to a slow reader\n", failed ? "FAIL" : "OK", file_len);
+    return failed;
+}
+
+pid_t start_server(int argc, char *argv[]) {
+    char *args[argc + 2];
+    int n = 0;
+    args[n++] = argv[1];
+    args[n++] = "-p";
+    args[n++] = argv[2];
+    for (int i = 3; i < argc; ++i) {
+        args[n++] = argv[i];
+    }
+    args[n] = NULL;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        if (null_fd >= 0) {
+            dup2(null_fd, STDOUT_FILENO);
+            dup2(null_fd, STDERR_FILENO);
+        }
+        execv(argv[1], args);
+        _exit(127);
+    }
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(atoi(argv[2]))};
+    inet_pton(AF_INET, HOST, &addr.sin_addr);
+    for (int waited = 0; waited < SERVER_START_MS; waited += 20) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *) &addr, sizeof(addr)) == 0) {
+            close(fd);
+            return pid;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        usleep(20000);
+    }
+    fprintf(stderr, "server %s did not start listening on %s\n", argv[1], argv[2]);
+    stop_server(pid);
+    return -1;
+}
+
+void stop_server(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+// the receive buffer is set before connect, so the window stays small
+int connect_client(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    int rcvbuf = RCVBUF;
+    struct timeval timeout = {.tv_sec = IO_TIMEOUT_S};
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    inet_pton(AF_INET, HOST, &addr.sin_addr);
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        perror("connect");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+char *read_file(const char *path, size_t *len) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    char *data = malloc(st.st_size);
+    if (data == NULL || read_full(fd, data, st.st_size) != st.st_size) {
+        fprintf(stderr, "%s: short read\n", path);
+        free(data);
+        close(fd);
+        return NULL;
+    }
+    close(fd);
+    *len = st.st_size;
+    return data;
+}
+
+// the header block byte by byte, nothing of the body behind it is consumed
+int read_head(int fd, char *head, size_t head_max, int *status, size_t *len) {
+    size_t n = 0;
+    while (n < 4 || memcmp(head + n - 4, "\r\n\r\n", 4) != 0) {
+        if (n + 1 >= head_max || read_full(fd, head + n, 1) != 1) {
+            return -1;
+        }
+        n++;
+    }
+    head[n] = '\0';
+
+    if (sscanf(head, "HTTP/1.1 %d", status) != 1) {
+        return -1;
+    }
+    const char *length = strcasestr(head, "\r\nContent-Length:");
+    *len = length != NULL ? strtoul(length + strlen("\r\nContent-Length:"), NULL, 10) : 0;
+    return 0;
+}
+
+// one response: its header block, then its body
+int read_response(int fd, char *head, size_t head_max, char *body, size_t body_max, int *status, size_t *len) {
+    if (read_head(fd, head, head_max, status, len) < 0 || *len > body_max) {
+        return -1;
+    }
+    return read_full(fd, body, *len) == (ssize_t) *len ? 0 : -1;
+}
+
+ssize_t read_full(int fd, char *buff, size_t n) {
+    size_t done = 0;
+    while (done < n) {
+        ssize_t rc = read(fd, buff + done, n - done);
+        if (rc < 0 && errno == EINTR) {
+            continue;
+        }
+        if (rc <= 0) {
+            break;
+        }
+        done += rc;
+    }
+    return (ssize_t) done;
+}
@@ -9,55 +9,77 @@ void *routine(void *routine_args);
 
 routine_args_t *new_args(tPoolT *pool, int num);
 
+int shared_add_task(tPoolT *pool, taskT *task);
+
+int stealing_add_task(tPoolT *pool, taskT *task);
+
+int pick_worker(tPoolT *pool);
+
+void wake_worker(tWorkerT *worker);
+
+void shared_loop(tPoolT *pool);
+
+void stealing_loop(tPoolT *pool, int num);
+
+bool take_task(tPoolT *pool, int num, taskT *task);
+
+bool has_tasks(tPoolT *pool);
+
 tPoolT *tPoolNew(int nThreads) {
+    return tPoolNewSched(nThreads, TPOOL_SHARED);
+}
+
+tPoolT *tPoolNewSched(int nThreads, tPoolSchedT sched) {
     tPoolT *pool = calloc(1, sizeof(tPoolT));
     if (pool == NULL) {
         logFatal(ERR_FSTR, "ThreadPool alloc failed", strerror(errno));
         return NULL;
     }
-
-    pool->queue = queueNew();
-    if (pool->queue == NULL) {
-        logFatal(ERR_FSTR, "queue alloc failed", strerror(errno));
-        free(pool);
-        return NULL;
-    }
-    pool->queue->len = 0;
+    pool->sched = sched;
 
     pool->threads = calloc(nThreads, sizeof(pthread_t));
     if (pool->threads == NULL) {
         logFatal(ERR_FSTR, "pthreads alloc failed", strerror(errno));
-        queueFree(pool->queue);
         free(pool);
         return NULL;
     }
     pool->nThreads = nThreads;
 
-    pool->qMutex = calloc(1, sizeof(pthread_mutex_t));
-    if (pool->qMutex == NULL) {
-        logFatal(ERR_FSTR, "mutex alloc failed", strerror(errno));
-        queueFree(pool->queue);
-        free(pool->threads);
-        free(pool);
-        return NULL;
+    if (sched == TPOOL_SHARED) {
+        pool->queue = ringNew(TASK_QUEUE_SIZE);
+        if (pool->queue == NULL) {
+            free(pool->threads);
+            free(pool);
+            return NULL;
+        }
+        logInfo("ThreadPool created");
+        return pool;
     }
 
-    pool->sem = calloc(1, sizeof(sem_t));
-    if (pool->sem == NULL) {
-        logFatal(ERR_FSTR, "cond var alloc failed", strerror(errno));
-        queueFree(pool->queue);
+    pool->workers = aligned_alloc(CACHE_LINE, nThreads * sizeof(tWorkerT));
+    if (pool->workers == NULL) {
+        logFatal(ERR_FSTR, "workers alloc failed", strerror(errno));
         free(pool->threads);
-        free(pool->qMutex);
         free(pool);
         return NULL;
     }
+    memset(pool->workers, 0, nThreads * sizeof(tWorkerT));
 
-
-    pthread_mutex_init(pool->qMutex, NULL);
-    sem_init(pool->sem, 0, 0);
+    for (int i = 0; i < nThreads; ++i) {
+        pool->workers[i].queue = ringNew(WORKER_QUEUE_SIZE);
+        if (pool->workers[i].queue == NULL) {
+            for (int j = 0; j < i; ++j) {
+                ringFree(pool->workers[j].queue);
+            }
+            free(pool->workers);
+            free(pool->threads);
+            free(pool);
+            return NULL;
+        }
+    }
+    pool->spin = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? RING_SPIN : 0;
 
     logInfo("ThreadPool created");
-
     return pool;
 }
 
@@ -65,12 +87,16 @@ void tPoolFree(tPoolT *tPool) {
     if (!tPool->stopped) {
         return;
     }
-    sem_destroy(tPool->sem);
-    free(tPool->sem);
-    pthread_mutex_destroy(tPool->qMutex);
-    free(tPool->qMutex);
+    if (tPool->sched == TPOOL_SHARED) {
+        ringFree(tPool->queue);
+    } else {
+        for (int i = 0; i < tPool->nThreads; ++i) {
+            logInfo("worker-%d: %llu tasks, %llu stolen", i, tPool->workers[i].done, tPool->workers[i].stolen);
+            ringFree(tPool->workers[i].queue);
+        }
+        free(tPool->workers);
+    }
     free(tPool->threads);
-    queueFree(tPool->queue);
     free(tPool);
 }
 
@@ -98,38 +124,29 @@ int tPoolStart(tPoolT *tPool) {
         return -1;
     }
 
-    logInfo("ThreadPool started (thread num = %d)", tPool->nThreads);
+    logInfo("ThreadPool started (thread num = %d, scheduler = %s)", tPool->nThreads, tPoolSchedName(tPool->sched));
 
     return 0;
 }
 
+// the task is copied, the caller keeps ownership of *task
 int tPoolAddTask(tPoolT *tPool, taskT *task) {
-    pthread_mutex_lock(tPool->qMutex);
-    // ===== CRITICAL SECTION =====
-    int rc = queuePush(tPool->queue, task);
-    sem_post(tPool->sem);
-    // ============================
-    pthread_mutex_unlock(tPool->qMutex);
-
-    if (rc != 0) {
-        logFatal(ERR_FSTR, "tPoolAddTask error", strerror(errno));
-        return rc;
+    if (tPool->sched == TPOOL_SHARED) {
+        return shared_add_task(tPool, task);
     }
-
-    logDebug("task added (q len = %d)", tPool->queue->len);
-    return 0;
+    return stealing_add_task(tPool, task);
 }
 
 int tPoolStop(tPoolT *tPool) {
-    pthread_mutex_lock(tPool->qMutex);
-    // ===== CRITICAL SECTION =====
-    tPool->stopping = true;
+    atomic_store(&tPool->stopping, true);
     logInfo("Stopping flag is set");
-    for (int i = 0; i < tPool->nThreads; ++i) {
-        sem_post(tPool->sem);
+    if (tPool->sched == TPOOL_SHARED) {
+        ringWakeAll(tPool->queue);
+    } else {
+        for (int i = 0; i < tPool->nThreads; ++i) {
+            wake_worker(&tPool->workers[i]);
+        }
     }
-    // ============================
-    pthread_mutex_unlock(tPool->qMutex);
 
     struct timespec timeout;
     clock_gettime(CLOCK_REALTIME, &timeout);
@@ -173,35 +190,166 @@ void *routine(void *args) {
     int num = r_args->num;
     free(args);
 
-    taskT task;
     char name[15] = "";
     sprintf(name, "thread-%d", num);
     threadName = name;
 
-    while (true) {
-        sem_wait(pool->sem);
+    if (pool->sched == TPOOL_SHARED) {
+        shared_loop(pool);
+    } else {
+        stealing_loop(pool, num);
+    }
+    logDebug("stopped");
 
-        if (pool->stopping) {
-            logDebug("stopped");
-            break;
+    pthread_exit(NULL);
+}
+
+const char *tPoolSchedName(tPoolSchedT sched) {
+    switch (sched) {
+        case TPOOL_ROUND_ROBIN:
+            return "round-robin";
+        case TPOOL_LEAST_LOADED:
+            return "least-loaded";
+        default:
+            return "shared";
+    }
+}
+
+int shared_add_task(tPoolT *pool, taskT *task) {
+    if (ringPush(pool->queue, task) != 0) {
+        logError("task queue is full (len = %zu)", ringLen(pool->queue));
+        return -1;
+    }
+    return 0;
+}
+
+void shared_loop(tPoolT *pool) {
+    taskT task;
+    while (ringPopWait(pool->queue, &task, &pool->stopping) == 0) {
+        task.handler(task.arg);
+    }
+}
+
+int stealing_add_task(tPoolT *pool, taskT *task) {
+    int first = pick_worker(pool);
+    for (int i = 0; i < pool->nThreads; ++i) {
+        int num = (first + i) % pool->nThreads;
+        if (ringPush(pool->workers[num].queue, task) != 0) {
+            continue;
         }
 
-        pthread_mutex_lock(pool->qMutex);
-        // ===== CRITICAL SECTION =====
-        int rc = queuePop(pool->queue, &task);
-        if (rc != -1) {
-            logDebug("task taken (q len = %d)", pool->queue->len);
+        // pairs with the fence in stealing_loop: either we see a sleeper or it sees the task
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&pool->workers[num].sleeping, memory_order_relaxed)) {
+            wake_worker(&pool->workers[num]);
+        } else if (atomic_load_explicit(&pool->nSleeping, memory_order_relaxed) > 0) {
+            // the owner is busy, let an idle peer steal the task
+            for (int j = 0; j < pool->nThreads; ++j) {
+                if (atomic_load_explicit(&pool->workers[j].sleeping, memory_order_relaxed)) {
+                    wake_worker(&pool->workers[j]);
+                    break;
+                }
+            }
         }
-        // ============================
-        pthread_mutex_unlock(pool->qMutex);
+        return 0;
+    }
+
+    logError("all worker queues are full");
+    return -1;
+}
+
+int pick_worker(tPoolT *pool) {
+    if (pool->sched == TPOOL_ROUND_ROBIN) {
+        return (int) (atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed) % pool->nThreads);
+    }
+
+    // start the scan at a moving point so ties are spread across workers
+    int start = (int) (atomic_fetch_add_explicit(&pool->next, 1, memory_order_relaxed) % pool->nThreads);
+    int best = start;
+    size_t best_len = SIZE_MAX;
+    for (int i = 0; i < pool->nThreads; ++i) {
+        int num = (start + i) % pool->nThreads;
+        tWorkerT *worker = &pool->workers[num];
+        size_t len = ringLen(worker->queue);
+        if (len == 0 && atomic_load_explicit(&worker->sleeping, memory_order_relaxed)) {
+            return num;
+        }
+        if (len < best_len) {
+            best = num;
+            best_len = len;
+        }
+    }
+    return best;
+}
+
+void wake_worker(tWorkerT *worker) {
+    atomic_fetch_add(&worker->wakeSeq, 1);
+    futexWake(&worker->wakeSeq, 1);
+}
 
-        if (rc < 0) {
+void stealing_loop(tPoolT *pool, int num) {
+    tWorkerT *self = &pool->workers[num];
+    taskT task;
+
+    while (!atomic_load(&pool->stopping)) {
+        bool found = false;
+        for (int i = 0; i <= pool->spin && !found; ++i) {
+            found = take_task(pool, num, &task);
+            if (!found && i < pool->spin) {
+                cpuRelax();
+            }
+        }
+        if (found) {
+            task.handler(task.arg);
+            atomic_fetch_add_explicit(&self->done, 1, memory_order_relaxed);
             continue;
         }
 
-        task.handler(task.conn, task.wd);
-        logInfo("routine for task finished");
+        // announce the sleep first, then re-check every queue
+        unsigned seq = atomic_load(&self->wakeSeq);
+        atomic_store(&self->sleeping, true);
+        atomic_fetch_add(&pool->nSleeping, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (!has_tasks(pool) && !atomic_load(&pool->stopping)) {
+            futexWait(&self->wakeSeq, seq);
+        }
+        atomic_fetch_sub(&pool->nSleeping, 1);
+        atomic_store(&self->sleeping, false);
+    }
+}
+
+// own queue first, then steal from peers starting at the next one
+bool take_task(tPoolT *pool, int num, taskT *task) {
+    if (ringPop(pool->workers[num].queue, task) == 0) {
+        return true;
     }
 
-    pthread_exit(NULL);
+    for (int i = 1; i < pool->nThreads; ++i) {
+        int victim = (num + i) % pool->nThreads;
+        if (ringPop(pool->workers[victim].queue, task) == 0) {
+            atomic_fetch_add_explicit(&pool->workers[num].stolen, 1, memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool has_tasks(tPoolT *pool) {
+    for (int i = 0; i < pool->nThreads; ++i) {
+        if (ringLen(pool->workers[i].queue) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t tPoolQueueLen(tPoolT *tPool) {
+    if (tPool->sched == TPOOL_SHARED) {
+        return ringLen(tPool->queue);
+    }
+    size_t len = 0;
+    for (int i = 0; i < tPool->nThreads; ++i) {
+        len += ringLen(tPool->workers[i].queue);
+    }
+    return len;
 }
@@ -3,26 +3,55 @@
 #define _GNU_SOURCE
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
-#include <semaphore.h>
+#include <stdint.h>
+#include <unistd.h>
 #include "../queue/task.h"
-#include "../queue/queue.h"
+#include "../queue/ring.h"
 #include "../log/log.h"
 
+// max number of queued tasks, tPoolAddTask fails beyond it
+#define TASK_QUEUE_SIZE 65536
+// per-worker queue size of the work-stealing schedulers
+#define WORKER_QUEUE_SIZE 8192
+
+typedef enum tPoolSched {
+    TPOOL_SHARED,       // one queue shared by all workers
+    TPOOL_ROUND_ROBIN,  // per-worker queues filled in turn, idle workers steal
+    TPOOL_LEAST_LOADED, // per-worker queues, the shortest one gets the task, idle workers steal
+} tPoolSchedT;
+
+typedef struct tWorker {
+    _Alignas(CACHE_LINE) ringT *queue;
+    atomic_uint wakeSeq;
+    atomic_bool sleeping;
+
+    atomic_ullong done, stolen;
+} tWorkerT;
+
 typedef struct tPool {
     pthread_t *threads;
     int nThreads;
+    tPoolSchedT sched;
 
-    queueT *queue;
-    pthread_mutex_t *qMutex;
-    sem_t *sem;
+    // TPOOL_SHARED
+    ringT *queue;
 
-    bool stopping;
+    // work stealing
+    tWorkerT *workers;
+    atomic_uint next;
+    atomic_int nSleeping;
+    int spin;
+
+    atomic_bool stopping;
     bool stopped;
 } tPoolT;
 
 tPoolT *tPoolNew(int nThreads);
 
+tPoolT *tPoolNewSched(int nThreads, tPoolSchedT sched);
+
 void tPoolFree(tPoolT *tPool);
 
 int tPoolStart(tPoolT *tPool);
@@ -30,3 +59,8 @@ int tPoolStart(tPoolT *tPool);
 int tPoolAddTask(tPoolT *tPool, taskT *task);
 
 int tPoolStop(tPoolT *tPool);
+
+// tasks waiting in all queues, a snapshot
+size_t tPoolQueueLen(tPoolT *tPool);
+
+const char *tPoolSchedName(tPoolSchedT sched);